@@ -0,0 +1,111 @@
+// File:	chanThroughput.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_MESSAGES 1000000
+#define DEFAULT_FAN 4
+#define DEFAULT_CAPACITY 64
+
+long msg_num;
+int fan;
+
+my_chan_t chan;
+
+/* what the receivers added up, to check every message got through exactly once */
+long received_sum = 0;
+pthread_mutex_t mutex;
+
+/* sends count messages, first + 1 up to first + count, straight through the pointer */
+void sender(void* arg) {
+	long first = ((long*)arg)[0], count = ((long*)arg)[1];
+	long i = 0;
+	for (i = 0; i < count; ++i)
+		my_chan_send(&chan, (void*)(first + i + 1));
+}
+
+/* receives until the channel is closed and drained */
+void receiver(void* arg) {
+	long sum = 0;
+	void *msg;
+	while (my_chan_recv(&chan, &msg) == 0)
+		sum += (long)msg;
+	pthread_mutex_lock(&mutex);
+	received_sum += sum;
+	pthread_mutex_unlock(&mutex);
+}
+
+static long elapsed_us(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* senders share msg_num messages, the channel is closed once they are all sent */
+static void run(const char *name, int senders, int receivers, unsigned int capacity) {
+	int i = 0;
+	pthread_t *send_thread = (pthread_t*)malloc(senders*sizeof(pthread_t));
+	pthread_t *recv_thread = (pthread_t*)malloc(receivers*sizeof(pthread_t));
+	long (*range)[2] = malloc(senders*sizeof(*range));
+	struct timespec start, end;
+
+	my_chan_init(&chan, capacity);
+	received_sum = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < receivers; ++i)
+		pthread_create(&recv_thread[i], NULL, &receiver, NULL);
+	for (i = 0; i < senders; ++i) {
+		range[i][0] = msg_num / senders * i;
+		range[i][1] = i == senders - 1 ? msg_num - range[i][0] : msg_num / senders;
+		pthread_create(&send_thread[i], NULL, &sender, range[i]);
+	}
+	for (i = 0; i < senders; ++i)
+		pthread_join(send_thread[i], NULL);
+	my_chan_close(&chan);
+	for (i = 0; i < receivers; ++i)
+		pthread_join(recv_thread[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	my_chan_destroy(&chan);
+
+	long us = elapsed_us(&start, &end);
+	printf("%-4s %-9s %10.0f msgs/sec%s\n", name,
+	       capacity == MY_CHAN_UNBOUNDED ? "unbounded" : "bounded", msg_num * 1000000.0 / (us > 0 ? us : 1),
+	       received_sum == msg_num * (msg_num + 1) / 2 ? "" : "  (messages lost)");
+
+	free(send_thread);
+	free(recv_thread);
+	free(range);
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("chanThroughput needs my_chan\n");
+	return 0;
+#else
+	msg_num = argc > 1 ? atol(argv[1]) : DEFAULT_MESSAGES;
+	fan = argc > 2 ? atoi(argv[2]) : DEFAULT_FAN;
+	unsigned int capacity = argc > 3 ? atoi(argv[3]) : DEFAULT_CAPACITY;
+	if (msg_num < 1 || fan < 1 || capacity < 1) {
+		printf("enter a valid number of messages, fan and capacity\n");
+		return 0;
+	}
+
+	pthread_mutex_init(&mutex, NULL);
+
+	printf("%ld messages, fan %d, bounded capacity %u\n", msg_num, fan, capacity);
+	run("1:1", 1, 1, capacity);
+	run("1:1", 1, 1, MY_CHAN_UNBOUNDED);
+	run("N:1", fan, 1, capacity);
+	run("N:1", fan, 1, MY_CHAN_UNBOUNDED);
+	run("1:N", 1, fan, capacity);
+	run("1:N", 1, fan, MY_CHAN_UNBOUNDED);
+
+	pthread_mutex_destroy(&mutex);
+	return 0;
+#endif
+}
@@ -0,0 +1,112 @@
+// File:	condPingPong.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_ROUNDS 100000
+#define DEFAULT_PAIRS 1
+
+/* a ball two threads pass back and forth, turn says whose it is */
+typedef struct pair {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	volatile int turn;
+} pair;
+
+int rounds, pair_num;
+
+pair *pairs;
+
+pthread_t *thread;
+
+/* waits for its turn on the condition variable, then hands the ball over */
+void cond_player(void* arg) {
+	long id = (long)arg;
+	pair *p = &pairs[id / 2];
+	int me = id % 2;
+	int i = 0;
+	for (i = 0; i < rounds; ++i) {
+		pthread_mutex_lock(&p->lock);
+		while (p->turn != me)
+			pthread_cond_wait(&p->cond, &p->lock);
+		p->turn = !me;
+		pthread_cond_signal(&p->cond);
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+/* yields until it is its turn, then hands the ball over */
+void yield_player(void* arg) {
+	long id = (long)arg;
+	pair *p = &pairs[id / 2];
+	int me = id % 2;
+	int i = 0;
+	for (i = 0; i < rounds; ++i) {
+		while (p->turn != me) {
+#ifdef USE_MY_PTHREAD
+			pthread_yield();
+#else
+			sched_yield();
+#endif
+		}
+		p->turn = !me;
+	}
+}
+
+/* plays every pair to the end and returns ns per round trip of one pair */
+static double play(void (*player)(void*)) {
+	long i = 0;
+	struct timespec start, end;
+
+	for (i = 0; i < pair_num; ++i) {
+		pthread_mutex_init(&pairs[i].lock, NULL);
+		pthread_cond_init(&pairs[i].cond, NULL);
+		pairs[i].turn = 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < pair_num * 2; ++i)
+		pthread_create(&thread[i], NULL, player, (void*)i);
+	for (i = 0; i < pair_num * 2; ++i)
+		pthread_join(thread[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (i = 0; i < pair_num; ++i) {
+		pthread_cond_destroy(&pairs[i].cond);
+		pthread_mutex_destroy(&pairs[i].lock);
+	}
+	long ns = (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+	return (double)ns / rounds / pair_num;
+}
+
+int main(int argc, char **argv) {
+	rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+	pair_num = argc > 2 ? atoi(argv[2]) : DEFAULT_PAIRS;
+	if (rounds < 1 || pair_num < 1) {
+		printf("enter a valid round and pair count\n");
+		return 0;
+	}
+
+	// every pair shares one worker, so a waiter only gets the cpu back through a wakeup
+	pthread_setconcurrency(1);
+
+	pairs = (pair*)calloc(pair_num, sizeof(pair));
+	thread = (pthread_t*)malloc(pair_num * 2 * sizeof(pthread_t));
+
+	double cond_ns = play(&cond_player);
+	double yield_ns = play(&yield_player);
+	printf("%d pairs, %d rounds: condition variable %.1f ns per round trip, yield polling %.1f ns\n",
+	       pair_num, rounds, cond_ns, yield_ns);
+
+	free(pairs);
+	free(thread);
+	return 0;
+}
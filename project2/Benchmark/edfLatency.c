@@ -0,0 +1,134 @@
+// File:	edfLatency.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_PERIODIC 4
+#define DEFAULT_HOGS 8
+#define DEFAULT_SECONDS 2
+
+/* every periodic thread needs RUNTIME_USEC of its PERIOD_USEC, due by the end of the period */
+#define PERIOD_USEC 10000
+#define RUNTIME_USEC 1500
+#define WORK_USEC 1000
+
+int periodic_num, hog_num;
+
+pthread_t *periodic, *hog;
+
+/* each periodic thread leaves its counters here, its slot is gone once it is joined */
+my_pthread_edfstats_t *stats;
+int *admitted_ok;
+
+volatile int stop = 0;
+
+volatile long sink;
+
+/* burns cpu until main says stop */
+void spin(void* arg) {
+	while (!stop) {
+		sink++;
+	}
+}
+
+/* a job of WORK_USEC of cpu every period */
+void periodic_job(void* arg) {
+	int i = *(int*)arg;
+	my_pthread_t me = periodic[i];
+	if (my_pthread_setdeadline(RUNTIME_USEC, PERIOD_USEC, PERIOD_USEC) != 0) {
+		printf("thread %u was not admitted\n", me);
+		return;
+	}
+	while (!stop) {
+		unsigned long long start, ns;
+		my_pthread_getcputime(me, &start);
+		do {
+			sink++;
+			my_pthread_getcputime(me, &ns);
+		} while (ns - start < WORK_USEC * 1000ULL);
+		my_pthread_waitperiod();
+	}
+	admitted_ok[i] = my_pthread_getdeadlinestats(me, &stats[i]) == 0;
+}
+
+static long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("edfLatency needs the my_pthread EDF class\n");
+	return 0;
+#else
+	int i = 0;
+
+	periodic_num = argc > 1 ? atoi(argv[1]) : DEFAULT_PERIODIC;
+	hog_num = argc > 2 ? atoi(argv[2]) : DEFAULT_HOGS;
+	int seconds = argc > 3 ? atoi(argv[3]) : DEFAULT_SECONDS;
+	if (periodic_num < 1 || hog_num < 0 || seconds < 1) {
+		printf("enter a valid number of periodic threads, hogs and seconds\n");
+		return 0;
+	}
+
+	// admission is per worker, keep everything on one so the load is real
+	pthread_setconcurrency(1);
+
+	periodic = (pthread_t*)malloc(periodic_num*sizeof(pthread_t));
+	hog = (pthread_t*)malloc(hog_num*sizeof(pthread_t));
+	stats = (my_pthread_edfstats_t*)calloc(periodic_num, sizeof(my_pthread_edfstats_t));
+	admitted_ok = (int*)calloc(periodic_num, sizeof(int));
+	int *index = (int*)malloc(periodic_num*sizeof(int));
+
+	for (i = 0; i < hog_num; ++i)
+		pthread_create(&hog[i], NULL, &spin, NULL);
+	for (i = 0; i < periodic_num; ++i) {
+		index[i] = i;
+		pthread_create(&periodic[i], NULL, &periodic_job, &index[i]);
+	}
+
+	long end = now_ms() + seconds * 1000L;
+	while (now_ms() < end)
+		pthread_yield();
+	stop = 1;
+
+	for (i = 0; i < hog_num; ++i)
+		pthread_join(hog[i], NULL);
+	for (i = 0; i < periodic_num; ++i)
+		pthread_join(periodic[i], NULL);
+
+	unsigned long jobs = 0, misses = 0;
+	long long worst_lateness = 0;
+	unsigned long long worst_response = 0;
+	int admitted = 0;
+	for (i = 0; i < periodic_num; ++i) {
+		if (!admitted_ok[i])
+			continue;
+		if (admitted == 0 || stats[i].worst_lateness_ns > worst_lateness)
+			worst_lateness = stats[i].worst_lateness_ns;
+		if (stats[i].worst_response_ns > worst_response)
+			worst_response = stats[i].worst_response_ns;
+		jobs += stats[i].jobs;
+		misses += stats[i].misses;
+		admitted++;
+	}
+	printf("%d of %d periodic threads admitted next to %d hogs\n", admitted, periodic_num, hog_num);
+	printf("%lu jobs, %lu missed their deadline, worst response %llu us, worst lateness %lld us\n",
+	       jobs, misses, worst_response / 1000, worst_lateness / 1000);
+
+	free(periodic);
+	free(hog);
+	free(stats);
+	free(admitted_ok);
+	free(index);
+	return 0;
+#endif
+}
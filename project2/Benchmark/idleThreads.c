@@ -0,0 +1,98 @@
+// File:	idleThreads.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_THREAD_NUM 10000
+
+pthread_mutex_t   mutex;
+
+int thread_num;
+
+pthread_t *thread;
+
+/* every thread parks on the mutex main is holding */
+void idle_wait(void* arg) {
+	pthread_mutex_lock(&mutex);
+	pthread_mutex_unlock(&mutex);
+}
+
+/* resident set size of the process in KB */
+long rss_kb() {
+	long pages = 0, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (!f) {
+		return 0;
+	}
+	fscanf(f, "%ld %ld", &pages, &resident);
+	fclose(f);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int main(int argc, char **argv) {
+	int i = 0;
+	size_t stack_kb = 0;
+	int guard = 1;
+
+	thread_num = argc > 1 ? atoi(argv[1]) : DEFAULT_THREAD_NUM;
+	if (thread_num < 1) {
+		printf("enter a valid thread number\n");
+		return 0;
+	}
+	// optional stack size in KB, and 0 to drop the guard page
+	if (argc > 2)
+		stack_kb = atol(argv[2]);
+	if (argc > 3)
+		guard = atoi(argv[3]);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	if (stack_kb > 0)
+		pthread_attr_setstacksize(&attr, stack_kb * 1024);
+	pthread_attr_setguardsize(&attr, guard ? sysconf(_SC_PAGESIZE) : 0);
+
+	thread = (pthread_t*)malloc(thread_num*sizeof(pthread_t));
+	memset(thread, 0, thread_num*sizeof(pthread_t));
+
+	pthread_mutex_init(&mutex, NULL);
+	pthread_mutex_lock(&mutex);
+
+	long before = rss_kb();
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_REALTIME, &start);
+
+	for (i = 0; i < thread_num; ++i) {
+		if (pthread_create(&thread[i], &attr, &idle_wait, NULL) != 0) {
+			printf("create failed after %d threads (vm.max_map_count? try guard 0)\n", i);
+			break;
+		}
+	}
+	thread_num = i;
+
+	clock_gettime(CLOCK_REALTIME, &end);
+	long after = rss_kb();
+
+	printf("%d idle threads, created in %lu micro-seconds\n", thread_num,
+	       (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000);
+	printf("rss before: %ld KB, after: %ld KB, per thread: %.2f KB\n", before, after,
+	       thread_num > 0 ? (double)(after - before) / thread_num : 0.0);
+
+	pthread_mutex_unlock(&mutex);
+	for (i = 0; i < thread_num; ++i)
+		pthread_join(thread[i], NULL);
+
+	pthread_mutex_destroy(&mutex);
+	pthread_attr_destroy(&attr);
+	free(thread);
+
+	return 0;
+}
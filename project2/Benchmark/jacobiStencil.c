@@ -0,0 +1,141 @@
+// File:	jacobiStencil.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_THREAD_NUM 8
+#define DEFAULT_SIZE 32
+#define DEFAULT_ITERATIONS 5000
+
+int thread_num, size, iterations;
+
+pthread_t *thread;
+
+pthread_barrier_t barrier;
+
+/* two grids, every sweep reads one and writes the other */
+double *grid[2];
+
+/* one sweep over rows [first, last) of the interior, from grid[from] into the other grid */
+static void sweep(int from, int first, int last) {
+	double *in = grid[from], *out = grid[!from];
+	int i = 0, j = 0;
+	for (i = first; i < last; ++i)
+		for (j = 1; j < size - 1; ++j)
+			out[i*size + j] = 0.25 * (in[(i-1)*size + j] + in[(i+1)*size + j] +
+			                          in[i*size + j - 1] + in[i*size + j + 1]);
+}
+
+/* rows of the interior thread n sweeps */
+static void rows(long n, int *first, int *last) {
+	int interior = size - 2;
+	*first = 1 + interior * n / thread_num;
+	*last = 1 + interior * (n + 1) / thread_num;
+}
+
+/* every thread runs all the sweeps, meeting the others at the barrier after each one */
+void barrier_worker(void* arg) {
+	int first, last, it = 0;
+	rows((long)arg, &first, &last);
+	for (it = 0; it < iterations; ++it) {
+		sweep(it % 2, first, last);
+		pthread_barrier_wait(&barrier);
+	}
+}
+
+int sweep_from;
+
+/* one sweep and done, main joins and creates the threads again for the next */
+void respawn_worker(void* arg) {
+	int first, last;
+	rows((long)arg, &first, &last);
+	sweep(sweep_from, first, last);
+}
+
+/* hot top edge, cold everywhere else */
+static void reset() {
+	int k = 0;
+	memset(grid[0], 0, size * size * sizeof(double));
+	memset(grid[1], 0, size * size * sizeof(double));
+	for (k = 0; k < size; ++k)
+		grid[0][k] = grid[1][k] = 100.0;
+}
+
+static double checksum() {
+	double sum = 0;
+	int k = 0;
+	for (k = 0; k < size * size; ++k)
+		sum += grid[iterations % 2][k];
+	return sum;
+}
+
+static long elapsed_us(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+int main(int argc, char **argv) {
+	long i = 0;
+	int it = 0;
+	struct timespec start, end;
+
+	thread_num = argc > 1 ? atoi(argv[1]) : DEFAULT_THREAD_NUM;
+	size = argc > 2 ? atoi(argv[2]) : DEFAULT_SIZE;
+	iterations = argc > 3 ? atoi(argv[3]) : DEFAULT_ITERATIONS;
+	if (thread_num < 1 || size < 3 || size - 2 < thread_num || iterations < 1) {
+		printf("enter a valid thread number, grid size and iteration count\n");
+		return 0;
+	}
+
+	thread = (pthread_t*)malloc(thread_num*sizeof(pthread_t));
+	grid[0] = (double*)malloc(size * size * sizeof(double));
+	grid[1] = (double*)malloc(size * size * sizeof(double));
+
+	// threads live through every sweep and wait for each other at a barrier
+	reset();
+	pthread_barrier_init(&barrier, NULL, thread_num);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < thread_num; ++i)
+		pthread_create(&thread[i], NULL, &barrier_worker, (void*)i);
+	for (i = 0; i < thread_num; ++i)
+		pthread_join(thread[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_barrier_destroy(&barrier);
+	long barrier_us = elapsed_us(&start, &end);
+	double barrier_sum = checksum();
+
+	// a fresh set of threads for every sweep, joined before the next
+	reset();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (it = 0; it < iterations; ++it) {
+		sweep_from = it % 2;
+		for (i = 0; i < thread_num; ++i)
+			pthread_create(&thread[i], NULL, &respawn_worker, (void*)i);
+		for (i = 0; i < thread_num; ++i)
+			pthread_join(thread[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	long respawn_us = elapsed_us(&start, &end);
+	double respawn_sum = checksum();
+
+	// the same sweeps on one thread
+	reset();
+	for (it = 0; it < iterations; ++it)
+		sweep(it % 2, 1, size - 1);
+	double verified_sum = checksum();
+
+	printf("%d threads, %dx%d grid, %d sweeps: barrier %ld micro-seconds, join and respawn %ld micro-seconds\n",
+	       thread_num, size, size, iterations, barrier_us, respawn_us);
+	printf("barrier sum %.6f, respawn sum %.6f, verified sum %.6f\n", barrier_sum, respawn_sum, verified_sum);
+
+	free(grid[0]);
+	free(grid[1]);
+	free(thread);
+	return 0;
+}
@@ -0,0 +1,123 @@
+// File:	pipelineHop.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_STAGES 4
+#define DEFAULT_HOPS 200000
+#define DEFAULT_HOGS 8
+
+int stage_num, hog_num;
+long hop_num;
+
+pthread_t *stage, *hog;
+
+/* the stage holding the token, and how often it has moved on */
+volatile int turn = 0;
+volatile long hops = 0;
+int directed = 0;
+
+volatile int stop = 0;
+
+volatile long sink;
+
+/* burns cpu until main says stop */
+void spin(void* arg) {
+	while (!stop) {
+		sink++;
+	}
+}
+
+/* 
+ * waits for the token, passes it to the next stage in the ring. Waiting is
+ * a plain yield, or a directed one to whoever holds the token so it gets
+ * the cpu before anything the policy would rather run.
+ */
+void pipeline_stage(void* arg) {
+	int me = *(int*)arg;
+	while (1) {
+		while (turn != me && hops < hop_num) {
+			if (directed)
+				my_pthread_yield_to(stage[turn]);
+			else
+				pthread_yield();
+		}
+		if (hops >= hop_num)
+			break;
+		hops++;
+		turn = (me + 1) % stage_num;
+		if (directed)
+			my_pthread_yield_to(stage[turn]);
+		else
+			pthread_yield();
+	}
+}
+
+static long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000L + (end->tv_nsec - start->tv_nsec);
+}
+
+/* runs the ring once, returns ns per hop */
+static long run(int yield_to) {
+	int i = 0;
+	int *index = (int*)malloc(stage_num*sizeof(int));
+	struct timespec start, end;
+
+	directed = yield_to;
+	turn = 0;
+	hops = 0;
+	stop = 0;
+	for (i = 0; i < hog_num; ++i)
+		pthread_create(&hog[i], NULL, &spin, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < stage_num; ++i) {
+		index[i] = i;
+		pthread_create(&stage[i], NULL, &pipeline_stage, &index[i]);
+	}
+	for (i = 0; i < stage_num; ++i)
+		pthread_join(stage[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	stop = 1;
+	for (i = 0; i < hog_num; ++i)
+		pthread_join(hog[i], NULL);
+
+	free(index);
+	return elapsed_ns(&start, &end) / hop_num;
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("pipelineHop needs my_pthread_yield_to\n");
+	return 0;
+#else
+	stage_num = argc > 1 ? atoi(argv[1]) : DEFAULT_STAGES;
+	hop_num = argc > 2 ? atol(argv[2]) : DEFAULT_HOPS;
+	hog_num = argc > 3 ? atoi(argv[3]) : DEFAULT_HOGS;
+	if (stage_num < 2 || hop_num < 1 || hog_num < 0) {
+		printf("enter a valid number of stages, hops and hogs\n");
+		return 0;
+	}
+
+	// the ring runs on one worker, so every hop is a switch
+	pthread_setconcurrency(1);
+
+	stage = (pthread_t*)malloc(stage_num*sizeof(pthread_t));
+	hog = (pthread_t*)malloc(hog_num*sizeof(pthread_t));
+
+	long yield_ns = run(0);
+	long yield_to_ns = run(1);
+	printf("%d stages, %d hogs, %ld hops under %s: yield %ld ns per hop, yield_to %ld ns per hop\n",
+	       stage_num, hog_num, hop_num, my_pthread_getpolicy(), yield_ns, yield_to_ns);
+
+	free(stage);
+	free(hog);
+	return 0;
+#endif
+}
@@ -0,0 +1,133 @@
+// File:	rwlockRead.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_THREAD_NUM 8
+#define DEFAULT_WRITE_PERCENT 1
+#define DEFAULT_OPS 20000
+
+/* a lookup scans SCAN entries of the table under the lock */
+#define TABLE_SIZE 4096
+#define SCAN 256
+
+int thread_num, write_percent, ops;
+
+pthread_t *thread;
+
+pthread_mutex_t mutex;
+pthread_rwlock_t rwlock;
+
+long table[TABLE_SIZE];
+
+volatile long sink;
+
+/* readers and writers in the write_percent mix, all behind one mutex */
+void mutex_worker(void* arg) {
+	unsigned int seed = (unsigned long)arg;
+	int i = 0, j = 0;
+	for (i = 0; i < ops; ++i) {
+		int at = rand_r(&seed) % TABLE_SIZE;
+		if (rand_r(&seed) % 100 < write_percent) {
+			pthread_mutex_lock(&mutex);
+			table[at]++;
+			pthread_mutex_unlock(&mutex);
+		} else {
+			long sum = 0;
+			pthread_mutex_lock(&mutex);
+			for (j = 0; j < SCAN; ++j)
+				sum += table[(at + j) % TABLE_SIZE];
+			pthread_mutex_unlock(&mutex);
+			sink = sum;
+		}
+	}
+}
+
+/* the same mix with the lookups sharing a reader-writer lock */
+void rwlock_worker(void* arg) {
+	unsigned int seed = (unsigned long)arg;
+	int i = 0, j = 0;
+	for (i = 0; i < ops; ++i) {
+		int at = rand_r(&seed) % TABLE_SIZE;
+		if (rand_r(&seed) % 100 < write_percent) {
+			pthread_rwlock_wrlock(&rwlock);
+			table[at]++;
+			pthread_rwlock_unlock(&rwlock);
+		} else {
+			long sum = 0;
+			pthread_rwlock_rdlock(&rwlock);
+			for (j = 0; j < SCAN; ++j)
+				sum += table[(at + j) % TABLE_SIZE];
+			pthread_rwlock_unlock(&rwlock);
+			sink = sum;
+		}
+	}
+}
+
+/* writes every thread's seed makes, to check no update got lost */
+static long expected_writes() {
+	long writes = 0;
+	long i = 0;
+	int j = 0;
+	for (i = 0; i < thread_num; ++i) {
+		unsigned int seed = i + 1;
+		for (j = 0; j < ops; ++j) {
+			rand_r(&seed);
+			if (rand_r(&seed) % 100 < write_percent)
+				writes++;
+		}
+	}
+	return writes;
+}
+
+/* runs every thread through the mix and returns the elapsed micro-seconds */
+static long run(void (*worker)(void*)) {
+	long i = 0;
+	struct timespec start, end;
+
+	memset(table, 0, sizeof(table));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < thread_num; ++i)
+		pthread_create(&thread[i], NULL, worker, (void*)(i + 1));
+	for (i = 0; i < thread_num; ++i)
+		pthread_join(thread[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long writes = 0;
+	for (i = 0; i < TABLE_SIZE; ++i)
+		writes += table[i];
+	if (writes != expected_writes())
+		printf("lost updates: %ld of %ld writes landed\n", writes, expected_writes());
+	return (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+int main(int argc, char **argv) {
+	thread_num = argc > 1 ? atoi(argv[1]) : DEFAULT_THREAD_NUM;
+	write_percent = argc > 2 ? atoi(argv[2]) : DEFAULT_WRITE_PERCENT;
+	ops = argc > 3 ? atoi(argv[3]) : DEFAULT_OPS;
+	if (thread_num < 1 || write_percent < 0 || write_percent > 100 || ops < 1) {
+		printf("enter a valid thread number, write percentage and op count\n");
+		return 0;
+	}
+
+	thread = (pthread_t*)malloc(thread_num*sizeof(pthread_t));
+	pthread_mutex_init(&mutex, NULL);
+	pthread_rwlock_init(&rwlock, NULL);
+
+	long mutex_us = run(&mutex_worker);
+	long rwlock_us = run(&rwlock_worker);
+	printf("%d threads, %d%% writes, %d ops each: mutex %ld micro-seconds, rwlock %ld micro-seconds\n",
+	       thread_num, write_percent, ops, mutex_us, rwlock_us);
+
+	pthread_rwlock_destroy(&rwlock);
+	pthread_mutex_destroy(&mutex);
+	free(thread);
+	return 0;
+}
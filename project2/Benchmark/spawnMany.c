@@ -0,0 +1,95 @@
+// File:	spawnMany.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_THREAD_NUM 10000
+
+int thread_num;
+
+pthread_t *thread;
+
+volatile long ran = 0;
+
+/* a thread that only says it ran */
+void short_job(void* arg) {
+	__sync_add_and_fetch(&ran, 1);
+}
+
+static long elapsed_us(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* creates thread_num threads the way named, then joins them; prints create and total time */
+static void spawn(const char *name, pthread_attr_t *attr, int batch) {
+	int i = 0;
+	struct timespec start, created, end;
+	ran = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (batch) {
+		if (my_pthread_create_n(thread, thread_num, attr, &short_job, NULL) != 0) {
+			printf("%s: create failed\n", name);
+			return;
+		}
+	} else {
+		for (i = 0; i < thread_num; ++i) {
+			if (pthread_create(&thread[i], attr, &short_job, NULL) != 0) {
+				printf("%s: create failed after %d threads\n", name, i);
+				return;
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &created);
+	for (i = 0; i < thread_num; ++i)
+		pthread_join(thread[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%-24s created in %8ld micro-seconds, all joined after %8ld (%ld ran)\n",
+	       name, elapsed_us(&start, &created), elapsed_us(&start, &end), ran);
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("spawnMany needs my_pthread_create_n\n");
+	return 0;
+#else
+	size_t stack_kb = 0;
+	int guard = 0;
+
+	thread_num = argc > 1 ? atoi(argv[1]) : DEFAULT_THREAD_NUM;
+	if (thread_num < 1) {
+		printf("enter a valid thread number\n");
+		return 0;
+	}
+	// optional stack size in KB, and 1 for a guard page per stack
+	if (argc > 2)
+		stack_kb = atol(argv[2]);
+	if (argc > 3)
+		guard = atoi(argv[3]);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	if (stack_kb > 0)
+		pthread_attr_setstacksize(&attr, stack_kb * 1024);
+	pthread_attr_setguardsize(&attr, guard ? sysconf(_SC_PAGESIZE) : 0);
+
+	thread = (pthread_t*)malloc(thread_num*sizeof(pthread_t));
+
+	printf("%d threads\n", thread_num);
+	spawn("create, yield each", &attr, 0);
+	my_pthread_attr_setyield(&attr, 0);
+	spawn("create, no yield", &attr, 0);
+	my_pthread_attr_setyield(&attr, 1);
+	spawn("create_n", &attr, 1);
+
+	pthread_attr_destroy(&attr);
+	free(thread);
+	return 0;
+#endif
+}
@@ -0,0 +1,76 @@
+// File:	statsChurn.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_ROUNDS 2000
+#define ROUND_THREADS 64
+
+int rounds;
+
+volatile int stop = 0;
+
+volatile long reads = 0;
+
+/* a thread that does nothing, its stack is what churns */
+void short_job(void* arg) {
+}
+
+/* reads the stack counters over and over while main creates and joins */
+void reader(void* arg) {
+	my_pthread_stackstats_t stats;
+	while (!stop) {
+		my_pthread_getstackstats(&stats);
+		reads++;
+	}
+}
+
+static long elapsed_us(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("statsChurn needs my_pthread_getstackstats\n");
+	return 0;
+#else
+	int i = 0, r = 0;
+	pthread_t thread[ROUND_THREADS], read_thread;
+
+	rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+	if (rounds < 1) {
+		printf("enter a valid number of rounds\n");
+		return 0;
+	}
+
+	// the reader has to be preempted on the same worker that creates and exits
+	pthread_setconcurrency(1);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_create(&read_thread, NULL, &reader, NULL);
+	for (r = 0; r < rounds; ++r) {
+		for (i = 0; i < ROUND_THREADS; ++i)
+			pthread_create(&thread[i], NULL, &short_job, NULL);
+		for (i = 0; i < ROUND_THREADS; ++i)
+			pthread_join(thread[i], NULL);
+	}
+	stop = 1;
+	pthread_join(read_thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	my_pthread_stackstats_t stats;
+	my_pthread_getstackstats(&stats);
+	printf("%d rounds of %d threads next to a stats reader in %ld micro-seconds, %ld reads\n",
+	       rounds, ROUND_THREADS, elapsed_us(&start, &end), reads);
+	printf("stacks mapped %lu, reused %lu, pooled %lu\n", stats.mapped, stats.reused, stats.pooled);
+	return 0;
+#endif
+}
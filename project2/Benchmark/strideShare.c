@@ -0,0 +1,134 @@
+// File:	strideShare.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_THREAD_NUM 1000
+#define DEFAULT_SECONDS 5
+#define WARMUP_MS 500
+
+/* threads get WEIGHT_CLASSES different ticket counts, class c has (c+1)*100 */
+#define WEIGHT_CLASSES 4
+
+int thread_num;
+
+pthread_t *thread;
+
+volatile int stop = 0;
+
+volatile long sink;
+
+/* burns cpu until main says stop */
+void spin(void* arg) {
+	while (!stop) {
+		sink++;
+	}
+}
+
+static long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+/* main yields its way through the wait, it only needs its ticket share to see the clock */
+static void wait_ms(long ms) {
+	long end = now_ms() + ms;
+	while (now_ms() < end) {
+		pthread_yield();
+	}
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("strideShare needs the my_pthread stride policy\n");
+	return 0;
+#else
+	int i = 0;
+	int seconds = argc > 2 ? atoi(argv[2]) : DEFAULT_SECONDS;
+
+	thread_num = argc > 1 ? atoi(argv[1]) : DEFAULT_THREAD_NUM;
+	if (thread_num < WEIGHT_CLASSES || seconds < 1) {
+		printf("enter a valid thread number and time\n");
+		return 0;
+	}
+
+	// shares are kept per worker, so measure them on one
+	pthread_setconcurrency(1);
+	if (my_pthread_setpolicy("stride") != 0) {
+		printf("no stride policy\n");
+		return 0;
+	}
+	// creating is work too, main's pass mustn't run far ahead of the threads it makes
+	my_pthread_settickets(0, STRIDE1);
+
+	thread = (pthread_t*)malloc(thread_num*sizeof(pthread_t));
+	unsigned int *tickets = (unsigned int*)malloc(thread_num*sizeof(unsigned int));
+	unsigned long long *before = (unsigned long long*)malloc(thread_num*sizeof(unsigned long long));
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, MIN_STACK_SIZE * 4);
+	for (i = 0; i < thread_num; ++i) {
+		tickets[i] = (i % WEIGHT_CLASSES + 1) * 100;
+		my_pthread_attr_settickets(&attr, tickets[i]);
+		pthread_create(&thread[i], &attr, &spin, NULL);
+	}
+	my_pthread_settickets(0, DEFAULT_TICKETS);
+
+	// every thread has run its first slice by now, start counting from here
+	wait_ms(WARMUP_MS);
+	for (i = 0; i < thread_num; ++i)
+		my_pthread_getcputime(thread[i], &before[i]);
+	wait_ms(seconds * 1000L);
+
+	unsigned long long total = 0, total_tickets = 0;
+	unsigned long long class_used[WEIGHT_CLASSES] = {0};
+	unsigned long long class_tickets[WEIGHT_CLASSES] = {0};
+	for (i = 0; i < thread_num; ++i) {
+		unsigned long long after;
+		my_pthread_getcputime(thread[i], &after);
+		before[i] = after - before[i];
+		total += before[i];
+		total_tickets += tickets[i];
+		class_used[i % WEIGHT_CLASSES] += before[i];
+		class_tickets[i % WEIGHT_CLASSES] += tickets[i];
+	}
+	stop = 1;
+	for (i = 0; i < thread_num; ++i)
+		pthread_join(thread[i], NULL);
+
+	// error of a share relative to what its tickets entitle it to
+	double worst_class = 0, mean_thread = 0, worst_thread = 0;
+	for (i = 0; i < WEIGHT_CLASSES; ++i) {
+		double want = (double)class_tickets[i] / total_tickets;
+		double got = (double)class_used[i] / total;
+		double err = (got - want) / want * 100;
+		printf("tickets %d: %.2f%% of the cpu, entitled to %.2f%% (%+.2f%%)\n",
+		       (i + 1) * 100, got * 100, want * 100, err);
+		if (err < 0) err = -err;
+		if (err > worst_class) worst_class = err;
+	}
+	for (i = 0; i < thread_num; ++i) {
+		double want = (double)tickets[i] / total_tickets;
+		double err = ((double)before[i] / total - want) / want * 100;
+		if (err < 0) err = -err;
+		mean_thread += err / thread_num;
+		if (err > worst_thread) worst_thread = err;
+	}
+	printf("%d threads, %d s: worst class off by %.2f%%, threads off by %.2f%% on average, %.2f%% at worst\n",
+	       thread_num, seconds, worst_class, mean_thread, worst_thread);
+
+	free(thread);
+	free(tickets);
+	free(before);
+	return 0;
+#endif
+}
@@ -0,0 +1,60 @@
+// File:	switchLatency.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_SWITCHES 1000000
+
+int switches;
+
+pthread_t thread[2];
+
+/* two threads yielding back and forth, every yield is one switch */
+void ping_pong(void* arg) {
+	int i = 0;
+	for (i = 0; i < switches / 2; ++i) {
+#ifdef USE_MY_PTHREAD
+		pthread_yield();
+#else
+		sched_yield();
+#endif
+	}
+}
+
+int main(int argc, char **argv) {
+	int i = 0;
+
+	switches = argc > 1 ? atoi(argv[1]) : DEFAULT_SWITCHES;
+	if (switches < 2) {
+		printf("enter a valid switch count\n");
+		return 0;
+	}
+
+	// both threads have to share one worker to switch to each other
+	pthread_setconcurrency(1);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < 2; ++i)
+		pthread_create(&thread[i], NULL, &ping_pong, NULL);
+
+	for (i = 0; i < 2; ++i)
+		pthread_join(thread[i], NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long ns = (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+	printf("%d switches in %ld micro-seconds, %.1f ns per switch\n", switches, ns / 1000,
+	       (double)ns / switches);
+
+	return 0;
+}
@@ -0,0 +1,101 @@
+// File:	taskParallelCal.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define C_SIZE 100000
+#define R_SIZE 10000
+
+pthread_mutex_t   mutex;
+
+int*    a[R_SIZE];
+int	 pSum[R_SIZE];
+int  sum = 0;
+
+/* parallelCal's row sums over a contiguous block of rows, added to sum once per block */
+void parallel_calculate(long lo, long hi, void* arg) {
+	int i = 0;
+	long j = 0;
+	int local = 0;
+	for (j = lo; j < hi; ++j) {
+		for (i = 0; i < C_SIZE; ++i) {
+			pSum[j] += a[j][i] * i;
+		}
+		local += pSum[j];
+	}
+	pthread_mutex_lock(&mutex);
+	sum += local;
+	pthread_mutex_unlock(&mutex);
+}
+
+/* verification function */
+void verify() {
+	int i = 0, j = 0;
+	sum = 0;
+	memset(&pSum, 0, R_SIZE*sizeof(int));
+
+	for (j = 0; j < R_SIZE; j += 1) {
+		for (i = 0; i < C_SIZE; ++i) {
+			pSum[j] += a[j][i] * i;
+		}
+	}
+	for (j = 0; j < R_SIZE; j += 1) {
+		sum += pSum[j];
+	}
+	printf("verified sum is: %d\n", sum);
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("taskParallelCal needs the my_pthread task pool\n");
+	return 0;
+#else
+	int i = 0, j = 0;
+	// rows per task, 0 lets my_parallel_for pick
+	long grain = argc > 1 ? atol(argv[1]) : 0;
+	if (grain < 0) {
+		printf("enter a valid grain size\n");
+		return 0;
+	}
+
+	// initialize data array
+	for (i = 0; i < R_SIZE; ++i)
+		a[i] = (int*)malloc(C_SIZE*sizeof(int));
+
+	for (i = 0; i < R_SIZE; ++i)
+		for (j = 0; j < C_SIZE; ++j)
+			a[i][j] = j;
+
+	memset(&pSum, 0, R_SIZE*sizeof(int));
+
+	pthread_mutex_init(&mutex, NULL);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	my_parallel_for(0, R_SIZE, grain, &parallel_calculate, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("running time: %ld micro-seconds\n",
+	       (end.tv_sec - start.tv_sec) * 1000L + (end.tv_nsec - start.tv_nsec) / 1000000);
+
+	printf("sum is: %d\n", sum);
+
+	pthread_mutex_destroy(&mutex);
+
+	verify();
+
+	for (i = 0; i < R_SIZE; ++i)
+		free(a[i]);
+
+	return 0;
+#endif
+}
@@ -0,0 +1,84 @@
+// File:	taskVectorMultiply.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define VECTOR_SIZE 3000000
+
+pthread_mutex_t   mutex;
+
+int r[VECTOR_SIZE];
+int s[VECTOR_SIZE];
+int res = 0;
+
+/* vectorMultiply over a contiguous slice, added to res once per slice instead of once per element */
+void vector_multiply(long lo, long hi, void* arg) {
+	long i = 0;
+	int local = 0;
+	for (i = lo; i < hi; ++i) {
+		local += r[i] * s[i];
+	}
+	pthread_mutex_lock(&mutex);
+	res += local;
+	pthread_mutex_unlock(&mutex);
+}
+
+void verify() {
+	int i = 0;
+	res = 0;
+	for (i = 0; i < VECTOR_SIZE; i += 1) {
+		res += r[i] * s[i];
+	}
+	printf("verified res is: %d\n", res);
+}
+
+int main(int argc, char **argv) {
+#ifndef USE_MY_PTHREAD
+	printf("taskVectorMultiply needs the my_pthread task pool\n");
+	return 0;
+#else
+	int i = 0;
+	// elements per task, 0 lets my_parallel_for pick
+	long grain = argc > 1 ? atol(argv[1]) : 0;
+	if (grain < 0) {
+		printf("enter a valid grain size\n");
+		return 0;
+	}
+
+	// initialize data array
+	for (i = 0; i < VECTOR_SIZE; ++i) {
+		r[i] = i;
+		s[i] = i;
+	}
+
+	pthread_mutex_init(&mutex, NULL);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	my_parallel_for(0, VECTOR_SIZE, grain, &vector_multiply, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("running time: %ld micro-seconds\n",
+	       (end.tv_sec - start.tv_sec) * 1000L + (end.tv_nsec - start.tv_nsec) / 1000000);
+
+	printf("res is: %d\n", res);
+
+	unsigned long spins, parks;
+	my_pthread_mutex_getstats(&mutex, &spins, &parks);
+	printf("mutex spin acquires: %lu, parks: %lu\n", spins, parks);
+
+	pthread_mutex_destroy(&mutex);
+
+	verify();
+
+	return 0;
+#endif
+}
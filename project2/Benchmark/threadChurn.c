@@ -0,0 +1,94 @@
+// File:	threadChurn.c
+// Author:	Brian Schillaci, John Strauser
+// Date:	January 2019
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "../my_pthread_t.h"
+
+#define DEFAULT_THREAD_NUM 1000000
+#define DEFAULT_BATCH 1000
+
+/* progress lines per run */
+#define REPORTS 5
+
+int thread_num, batch;
+
+pthread_t *thread;
+
+volatile long done = 0;
+
+/* a thread that only says it finished */
+void short_job(void* arg) {
+	__sync_add_and_fetch(&done, 1);
+}
+
+/* resident set size of the process in KB */
+long rss_kb() {
+	long pages = 0, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (!f) {
+		return 0;
+	}
+	fscanf(f, "%ld %ld", &pages, &resident);
+	fclose(f);
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long elapsed_us(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* runs thread_num short threads batch at a time, joining each batch or leaving them detached */
+static void churn(int detach) {
+	int i = 0, created = 0;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	if (detach)
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	done = 0;
+	while (created < thread_num) {
+		int n = thread_num - created < batch ? thread_num - created : batch;
+		for (i = 0; i < n; ++i)
+			pthread_create(&thread[i], &attr, &short_job, NULL);
+		if (detach) {
+			while (done < created + n)
+				pthread_yield();
+		} else {
+			for (i = 0; i < n; ++i)
+				pthread_join(thread[i], NULL);
+		}
+		created += n;
+		if (created % (thread_num / REPORTS > 0 ? thread_num / REPORTS : 1) < n)
+			printf("  %s: %d threads, rss %ld KB\n", detach ? "detached" : "joined", created, rss_kb());
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%s: %d threads in %ld micro-seconds\n", detach ? "detached" : "joined", thread_num,
+	       elapsed_us(&start, &end));
+	pthread_attr_destroy(&attr);
+}
+
+int main(int argc, char **argv) {
+	thread_num = argc > 1 ? atoi(argv[1]) : DEFAULT_THREAD_NUM;
+	batch = argc > 2 ? atoi(argv[2]) : DEFAULT_BATCH;
+	if (thread_num < 1 || batch < 1) {
+		printf("enter a valid thread number and batch size\n");
+		return 0;
+	}
+
+	thread = (pthread_t*)malloc(batch*sizeof(pthread_t));
+
+	printf("rss at start: %ld KB\n", rss_kb());
+	churn(0);
+	churn(1);
+
+	free(thread);
+	return 0;
+}
@@ -91,6 +91,12 @@ int main(int argc, char **argv) {
 
 	printf("res is: %d\n", res);
 
+#ifdef USE_MY_PTHREAD
+	unsigned long spins, parks;
+	my_pthread_mutex_getstats(&mutex, &spins, &parks);
+	printf("mutex spin acquires: %lu, parks: %lu\n", spins, parks);
+#endif
+
 	pthread_mutex_destroy(&mutex);
 
 	// feel free to verify your answer here:
@@ -6,419 +6,3095 @@
 // username of iLab: bcs115, jps313
 // iLab Server: man.cs.rutgers.edu
 
+#define MY_PTHREAD_INTERNAL
 #include "my_pthread_t.h"
+#include <linux/futex.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* library internals, the header only declares the public API */
+static void schedule();
+static inline void preemptDisable();
+static inline void preemptEnable();
+static void scheduleNext(int requeue);
+static void switchTo(struct Worker * w, tcb * next, unsigned long long slice);
+static unsigned long long chargeSlice(struct Worker * w);
+static void finishSwitch();
+static void enqueueReady(struct Worker * w, tcb * t);
+static tcb * pickNext(struct Worker * w);
+static unsigned long long sliceOf(tcb * t);
+static void scheduleDirect(tcb * next);
+static int takeReady(tcb * t);
+static void sleepUntil(unsigned long long wake);
+static void workerLoop();
+void reset_timer(int signum);
+void fastSwitch(void ** saveSp, void * loadSp);
+static SchedOps * findPolicy(const char * name);
+extern SchedOps stcfOps;
+extern SchedOps mlfqOps;
+extern SchedOps strideOps;
+int insertTcbHeap(tcb * toInsert, TcbHeap * heap);
+tcb * popTcbHeap(TcbHeap * heap);
+void removeTcbHeap(tcb * toRemove, TcbHeap * heap);
+ThreadSlot * findSlot(my_pthread_t tid);
+void dequePush(WsDeque * deque, void * toPush);
+void * dequePop(WsDeque * deque);
+void * dequeSteal(WsDeque * deque);
+static int allocStacks(ThreadStack ** out, int n, size_t size, size_t guard);
+static void releaseStack(ThreadStack * st);
+static void recycleSlot(my_pthread_t tid, ThreadSlot * slot);
+static void chanPush(ChanQueue * queue, ChanWaiter * waiter);
+static void chanUnlink(ChanQueue * queue, ChanWaiter * waiter);
+static ChanWaiter * chanPop(ChanQueue * queue);
+static int chanPut(my_chan_t * chan, void * msg);
+static void * chanTake(my_chan_t * chan);
+static int chanTry(my_chan_case_t * c, ChanWaiter ** woken);
+static void lockChans(my_chan_case_t * cases, int * order, int n, int unlock);
+static void startPool();
+static void * taskLoop(void * arg);
+static Task * findTask(tcb * me);
+static void runTask(tcb * me, Task * task);
+static void spawnTask(tcb * me, Task * task);
+static void finishTask(TaskFrame * parent);
+static void splitRange(tcb * me, void (*body)(long, long, void *), long start, long end, long grain, void * arg);
 
 unsigned int tids = 0;
 
-// blocks ready to be scheduled
-TcbQueue * schedQueue;
+// thread table, chunk tid / SLOT_CHUNK holds the slot for tid
+ThreadSlot * slotChunks[MAX_SLOT_CHUNKS];
+volatile unsigned int slotLock = 0;
+// tids whose slots nobody can join any more, linked through next_free and ended by 0
+my_pthread_t freeTids = 0;
 
-//mlfq levels
-TcbQueue *queue2;
-TcbQueue *queue3;
-TcbQueue *queue4;
+int firstTimeRunning = 0;
 
-// blocks waiting on IO or a lock to be scheduled
-TcbQueue * waitQueue;
+// kernel workers, workers[0] is the kernel thread that made the first create
+worker workers[MAX_WORKERS];
+int numWorkers = 0;
 
-// return values queue
-RetQueue * retQueue;
+// stacks of exited threads, most recently freed first so they're still warm.
+// Only default sized stacks are pooled.
+ThreadStack * stackPool = NULL;
+int stackPoolCap = -1;
+my_pthread_stackstats_t stackStats;
+volatile unsigned int stackLock = 0;
 
-int firstTimeRunning = 0;
+// scheduling policy, SCHED in the Makefile picks the default
+#ifndef MLFQ
+SchedOps * policy = &stcfOps;
+#else
+SchedOps * policy = &mlfqOps;
+#endif
+int policySet = 0;
+
+// EDF utilization admitted so far, in millionths of a worker
+unsigned long edfUtil = 0;
+volatile unsigned int edfLock = 0;
+
+// MLFQ tuning, filled in from the environment by init unless set before
+my_pthread_mlfqattr_t mlfq;
+int mlfqSet = 0;
+
+// fork-join task pool, poolState goes 0 to 1 while the first spawn starts it and 2 once it runs
+TaskPool taskPool;
+volatile int poolState = 0;
+
+// idle workers sleep on wakeSeq until a thread is made ready
+volatile int wakeSeq = 0;
+volatile int idleWorkers = 0;
+
+/* 
+ * The worker running on this kernel thread, and how deep it is in sections
+ * the tick must not preempt. Both are only ever accessed with single
+ * fs-relative loads and stores so a thread that migrates between workers
+ * always sees its own.
+ */
+static __thread worker * volatile myWorker __attribute__((tls_model("initial-exec")));
+static __thread volatile int preemptCount __attribute__((tls_model("initial-exec")));
+
+#ifdef USE_FAST_SWITCH
+#ifdef SWITCH_FPU
+// the x87 control word and the MXCSR control bits are callee-saved too
+#define SAVE_FPU "    subq $16, %rsp\n    stmxcsr 8(%rsp)\n    fnstcw (%rsp)\n"
+#define LOAD_FPU "    ldmxcsr 8(%rsp)\n    fldcw (%rsp)\n    addq $16, %rsp\n"
+#define FPU_FRAME 2
+#else
+#define SAVE_FPU ""
+#define LOAD_FPU ""
+#define FPU_FRAME 0
+#endif
+
+/* 
+ * void fastSwitch(void ** saveSp, void * loadSp)
+ * Pushes the callee-saved registers, leaves the stack pointer in *saveSp
+ * and pops the other thread's off loadSp. The rest are caller-saved, so
+ * the compiler already spilled them around the call, and unlike
+ * swapcontext there's no sigprocmask syscall.
+ */
+__asm__(
+    ".text\n"
+    ".globl fastSwitch\n"
+    ".type fastSwitch, @function\n"
+    "fastSwitch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    SAVE_FPU
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    LOAD_FPU
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size fastSwitch, .-fastSwitch\n"
+);
+#endif
+
+static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause");
+#endif
+}
+
+static void spinLock(volatile unsigned int * lock) {
+    while (__sync_lock_test_and_set(lock, 1) == 1) {
+        while (*lock == 1) {
+            cpuRelax();
+        }
+    }
+}
+
+static void spinUnlock(volatile unsigned int * lock) {
+    __sync_lock_release(lock);
+}
+
+/* CLOCK_MONOTONIC in ns, a vDSO call so no syscall */
+static unsigned long long nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* 
+ * starts or stops this worker's periodic tick. It runs the whole time the
+ * worker has threads, so scheduling never has to touch it.
+ */
+static void armTimer(worker * w, int on) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (on) {
+        its.it_value.tv_nsec = RUN_TIME_USEC * 1000;
+        its.it_interval.tv_nsec = RUN_TIME_USEC * 1000;
+    }
+    timer_settime(w->timer, 0, &its, NULL);
+}
+
+/* every worker gets its own timer that only ever signals its kernel thread */
+static void createTimer(worker * w) {
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGALRM;
+    sev.sigev_notify_thread_id = w->ktid;
+    timer_create(CLOCK_MONOTONIC, &sev, &w->timer);
+    armTimer(w, 1);
+}
+/* 
+ * keeps the tick from switching threads until the matching preemptEnable,
+ * so queues and locks can be touched without masking SIGALRM
+ */
+static inline void preemptDisable() {
+    preemptCount++;
+    __asm__ __volatile__("" ::: "memory");
+}
+
+/* leaves a section, running the reschedule a tick deferred meanwhile */
+static inline void preemptEnable() {
+    __asm__ __volatile__("" ::: "memory");
+    if (--preemptCount == 0 && myWorker->need_resched) {
+        schedule();
+    }
+}
+
+/* the calling thread's tcb */
+static tcb * self() {
+    if (firstTimeRunning == 0) {
+        init();
+    }
+    preemptDisable();
+    tcb * t = myWorker->current;
+    preemptEnable();
+    return t;
+}
+
+/* racy check for threads on a worker's ready queues */
+static int hasReady(worker * w) {
+    int q;
+    if (w->readyHeap.root != NULL || w->edfHeap.root != NULL) {
+        return 1;
+    }
+    for (q = 0; q < mlfq.levels; q++) {
+        if (w->readyQueues[q].head != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* racy check used by idle workers before they go to sleep */
+static int anyReady() {
+    int i;
+    for (i = 0; i < numWorkers; i++) {
+        if (workers[i].fresh.bottom > workers[i].fresh.top || hasReady(&workers[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* kicks an idle worker after a thread was made ready */
+static void wakeWorker() {
+    if (numWorkers == 1) {
+        return;
+    }
+    __sync_add_and_fetch(&wakeSeq, 1);
+    if (idleWorkers > 0) {
+        syscall(SYS_futex, &wakeSeq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+/* MLFQ level a thread's priority maps to */
+static int levelOf(tcb * ptr) {
+    return ptr->priority < mlfq.levels - 1 ? ptr->priority : mlfq.levels - 1;
+}
+
+/* 
+ * puts a thread that was waiting back on a ready queue, the waker's worker
+ * takes it since it just touched whatever the thread was waiting for
+ */
+static void readyTcb(tcb * ptr) {
+    worker * w = myWorker;
+    spinLock(&w->lock);
+    ptr->thread_state = READY;
+    policy->on_wake(w, ptr);
+    enqueueReady(w, ptr);
+    spinUnlock(&w->lock);
+    wakeWorker();
+}
+
+/* 
+ * charges an EDF thread's job for the cpu it has used. Once the budget is
+ * gone the job carries on with a fresh one and its scheduling deadline a
+ * period later, so an overrunning thread can't take more than its
+ * reservation from the others.
+ */
+static void chargeEdf(tcb * t) {
+    EdfState * edf = t->edf;
+    if (t->run_time - edf->job_base >= edf->runtime) {
+        edf->job_base = t->run_time;
+        edf->abs_deadline += edf->period;
+    }
+}
+
+/* puts a runnable thread on w's EDF heap or the policy's queues, w->lock must be held */
+static void enqueueReady(worker * w, tcb * t) {
+    if (t->edf != NULL) {
+        t->key = t->edf->abs_deadline;
+        insertTcbHeap(t, &w->edfHeap);
+    } else {
+        policy->enqueue(w, t);
+    }
+    t->rq = w;
+}
+
+/* next thread to run off w's queues, EDF first, w->lock must be held */
+static tcb * pickNext(worker * w) {
+    tcb * t = w->edfHeap.root != NULL ? popTcbHeap(&w->edfHeap) : policy->pick_next(w);
+    if (t != NULL) {
+        t->rq = NULL;
+    }
+    return t;
+}
+
+/* whether rank a runs before rank b, passes wrap so this goes by difference */
+static int rankBefore(unsigned long long a, unsigned long long b) {
+    return (long long) (a - b) < 0;
+}
+
+/* the rank a thread is queued by, its own or the one it inherited */
+static unsigned long long effectiveRank(tcb * t, unsigned long long own) {
+    return t->pi_boosted && rankBefore(t->pi_rank, own) ? t->pi_rank : own;
+}
+
+/* 
+ * raises a mutex owner to a waiter's rank until it unlocks. An owner that
+ * sits on a ready queue is moved up right away, one that is running or
+ * blocked picks the rank up the next time it is queued. mutex->guard must
+ * be held, which serializes the waiters of one mutex.
+ */
+static void inheritRank(tcb * owner, unsigned long long rank) {
+    if (owner->edf != NULL || (owner->pi_boosted && !rankBefore(rank, owner->pi_rank))) {
+        return;
+    }
+    for (;;) {
+        worker * w = owner->rq;
+        if (w == NULL) {
+            owner->pi_rank = rank;
+            owner->pi_boosted = 1;
+            return;
+        }
+        spinLock(&w->lock);
+        if (owner->rq == w) {
+            policy->remove(w, owner);
+            owner->pi_rank = rank;
+            owner->pi_boosted = 1;
+            enqueueReady(w, owner);
+            spinUnlock(&w->lock);
+            return;
+        }
+        spinUnlock(&w->lock);
+    }
+}
+
+/* an EDF thread runs until its job's budget is gone, anything else gets the policy's slice */
+static unsigned long long sliceOf(tcb * t) {
+    return t->edf != NULL ? t->edf->runtime - (t->run_time - t->edf->job_base) : policy->slice(t);
+}
+
+/* readies w's sleepers whose time has come, w->lock must be held */
+static void wakeSleepers(worker * w, unsigned long long now) {
+    while (w->sleepers.root != NULL && (long long) (w->sleepers.root->key - now) <= 0) {
+        tcb * t = popTcbHeap(&w->sleepers);
+        t->sleeping_on = NULL;
+        // a timed condition waiter that was signalled first is readied by the signal
+        if (t->cond_wait != COND_NONE &&
+            !__sync_bool_compare_and_swap(&t->cond_wait, COND_WAITING, COND_TIMEDOUT)) {
+            continue;
+        }
+        t->thread_state = READY;
+        policy->on_wake(w, t);
+        enqueueReady(w, t);
+    }
+}
+
+/* 
+ * called once this worker has nothing of its own: try the other workers'
+ * fresh threads first, they are cheap to take, then their ready queues
+ */
+static tcb * stealWork(worker * w) {
+    int i;
+    tcb * stolen;
+    for (i = 1; i < numWorkers; i++) {
+        worker * victim = &workers[(w->id + i) % numWorkers];
+        stolen = dequeSteal(&victim->fresh);
+        if (stolen != NULL) {
+            return stolen;
+        }
+    }
+    for (i = 1; i < numWorkers; i++) {
+        worker * victim = &workers[(w->id + i) % numWorkers];
+        if (!hasReady(victim)) {
+            continue;
+        }
+        spinLock(&victim->lock);
+        stolen = pickNext(victim);
+        spinUnlock(&victim->lock);
+        if (stolen != NULL) {
+            return stolen;
+        }
+    }
+    return NULL;
+}
+
+static int defaultWorkers() {
+    char * env = getenv("MY_PTHREAD_WORKERS");
+    int n = env != NULL ? atoi(env) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) {
+        n = 1;
+    }
+    if (n > MAX_WORKERS) {
+        n = MAX_WORKERS;
+    }
+    return n;
+}
+
+/* fills a list of usec values like "200,400,800" from the environment */
+static void envUsecList(const char * name, unsigned int * out) {
+    char * env = getenv(name);
+    int q;
+    for (q = 0; env != NULL && *env != '\0' && q < MAX_MLFQ_LEVELS; q++) {
+        char * end;
+        unsigned long usec = strtoul(env, &end, 10);
+        if (end == env) {
+            return;
+        }
+        if (usec > 0) {
+            out[q] = usec;
+        }
+        env = *end == ',' ? end + 1 : end;
+    }
+}
+
+/* MLFQ tuning when my_pthread_setmlfq wasn't called, the environment overrides the defaults */
+static void defaultMlfq() {
+    my_pthread_mlfqattr_init(&mlfq);
+    char * env = getenv("MY_PTHREAD_MLFQ_LEVELS");
+    if (env != NULL && atoi(env) >= 1) {
+        mlfq.levels = atoi(env) < MAX_MLFQ_LEVELS ? atoi(env) : MAX_MLFQ_LEVELS;
+    }
+    envUsecList("MY_PTHREAD_MLFQ_QUANTA", mlfq.quantum_usec);
+    envUsecList("MY_PTHREAD_MLFQ_ALLOT", mlfq.allot_usec);
+    env = getenv("MY_PTHREAD_MLFQ_BOOST");
+    if (env != NULL) {
+        mlfq.boost_usec = strtoul(env, NULL, 10);
+    }
+}
+
+static void initDeque(WsDeque * deque) {
+    deque->top = 0;
+    deque->bottom = 0;
+    deque->array = calloc(1, sizeof(DequeArray) + 256 * sizeof(void *));
+    deque->array->mask = 255;
+}
+
+/* slot for a new tid, grows the table by a chunk when tid starts one */
+static ThreadSlot * newSlot(my_pthread_t tid) {
+    ThreadSlot ** chunk = &slotChunks[tid / SLOT_CHUNK];
+    if (__atomic_load_n(chunk, __ATOMIC_ACQUIRE) == NULL) {
+        spinLock(&slotLock);
+        if (*chunk == NULL) {
+            __atomic_store_n(chunk, calloc(SLOT_CHUNK, sizeof(ThreadSlot)), __ATOMIC_RELEASE);
+        }
+        spinUnlock(&slotLock);
+    }
+    return findSlot(tid);
+}
+
+static size_t roundPages(size_t bytes) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (bytes + page - 1) & ~(page - 1);
+}
+
+/* 
+ * lays a stack out in [base, base + length): guard at the bottom, the
+ * header with the tcb and context at the top and usable stack in between
+ */
+static ThreadStack * carveStack(char * base, size_t length, size_t guard, StackSlab * slab) {
+    // without a guard neighbouring stacks share one vma, which is what lets
+    // 100k+ threads fit under vm.max_map_count
+    if (guard > 0 && mprotect(base, roundPages(guard), PROT_NONE) != 0) {
+        return NULL;
+    }
+    ThreadStack * st = (ThreadStack *) (((uintptr_t) (base + length - sizeof(ThreadStack))) & ~(uintptr_t) 63);
+    st->base = base;
+    st->length = length;
+    st->guard = roundPages(guard);
+    st->slab = slab;
+    return st;
+}
+
+/* 
+ * takes a stack off the pool or maps a new one, the header with the tcb
+ * and context goes at the top and the rest is usable stack. The mapping is
+ * MAP_NORESERVE, so pages only get committed as the thread touches them.
+ */
+static ThreadStack * allocStack(size_t size, size_t guard) {
+    ThreadStack * st = NULL;
+    return allocStacks(&st, 1, size, guard) == 0 ? st : NULL;
+}
+
+/* 
+ * n stacks at once: what the pool has, then one mapping carved up for the
+ * rest. The mapping goes in one munmap once all of its stacks are back,
+ * rather than a split of the vma per exiting thread, so the pages they
+ * touched stay until the last thread of the batch exits.
+ */
+static int allocStacks(ThreadStack ** out, int n, size_t size, size_t guard) {
+    size_t length = roundPages(size) + roundPages(guard);
+    int pooled = size == STACK_SIZE && guard == sysconf(_SC_PAGESIZE);
+    int i, have = 0;
+
+    spinLock(&stackLock);
+    while (pooled && have < n && stackPool != NULL) {
+        out[have] = stackPool;
+        stackPool = stackPool->next;
+        stackStats.pooled--;
+        stackStats.reused++;
+        have++;
+    }
+    stackStats.mapped += n - have;
+    spinUnlock(&stackLock);
+    if (have == n) {
+        return 0;
+    }
+
+    StackSlab * slab = n - have > 1 ? malloc(sizeof(StackSlab)) : NULL;
+    char * base = MAP_FAILED;
+    if (n - have == 1 || slab != NULL) {
+        base = mmap(NULL, length * (n - have), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+    }
+    if (base != MAP_FAILED) {
+        if (slab != NULL) {
+            slab->base = base;
+            slab->length = length * (n - have);
+            slab->live = n - have;
+        }
+        for (i = have; i < n; i++) {
+            out[i] = carveStack(base + (i - have) * length, length, guard, slab);
+            if (out[i] == NULL) {
+                break;
+            }
+        }
+        if (i == n) {
+            return 0;
+        }
+        munmap(base, length * (n - have));
+    }
+    free(slab);
+    for (i = 0; i < have; i++) {
+        releaseStack(out[i]);
+    }
+    spinLock(&stackLock);
+    stackStats.mapped -= n - have;
+    spinUnlock(&stackLock);
+    return -1;
+}
+
+/* first usable byte of a stack, just above the guard */
+static char * stackBottom(ThreadStack * st) {
+    return st->base + st->guard;
+}
+
+/* gives a stack's memory back, a slab goes with the last of its stacks */
+static void unmapStack(ThreadStack * st) {
+    StackSlab * slab = st->slab;
+    if (slab == NULL) {
+        munmap(st->base, st->length);
+    } else if (__sync_sub_and_fetch(&slab->live, 1) == 0) {
+        munmap(slab->base, slab->length);
+        free(slab);
+    }
+}
+
+/* 
+ * puts an exited thread's stack back on the pool, unmaps it when the pool is
+ * full. Stacks of a batch skip the pool, one of them sitting there would
+ * keep the whole slab and the pages its threads touched mapped.
+ */
+static void releaseStack(ThreadStack * st) {
+    spinLock(&stackLock);
+    if (st->length == STACK_SIZE + sysconf(_SC_PAGESIZE) && st->guard == sysconf(_SC_PAGESIZE) &&
+        st->slab == NULL && stackStats.pooled < stackPoolCap) {
+        st->next = stackPool;
+        stackPool = st;
+        stackStats.pooled++;
+        if (stackStats.pooled > stackStats.high_water) {
+            stackStats.high_water = stackStats.pooled;
+        }
+        st = NULL;
+    }
+    spinUnlock(&stackLock);
+    if (st != NULL) {
+        unmapStack(st);
+    }
+}
+
+/* 
+ * sets up a context that starts running entry on the given stack the
+ * first time it is switched to
+ */
+static void makeThreadContext(tcb * t, char * stack, size_t size, void (*entry)()) {
+#ifdef USE_FAST_SWITCH
+    // a frame fastSwitch can pop: zeroed registers, then entry as the
+    // return address, then a fake return address for entry itself so it
+    // starts with the stack aligned the way a call would leave it
+    uintptr_t * top = (uintptr_t *) (((uintptr_t) (stack + size)) & ~(uintptr_t) 15);
+    uintptr_t * sp = top - 2 - 6 - FPU_FRAME;
+    memset(sp, 0, (top - sp) * sizeof(uintptr_t));
+    top[-2] = (uintptr_t) entry;
+#ifdef SWITCH_FPU
+    ((unsigned int *) sp)[0] = 0x037f;
+    ((unsigned int *) sp)[2] = 0x1f80;
+#endif
+    t->thread_sp = sp;
+#else
+    getcontext(t->thread_context);  
+    t->thread_context->uc_stack.ss_sp = stack;
+    t->thread_context->uc_stack.ss_size = size; 
+    t->thread_context->uc_stack.ss_flags = 0;  
+    t->thread_context->uc_link = 0; 
+    makecontext(t->thread_context, entry, 0); 
+#endif
+}
 
-// The currently running thread block
-tcb * currentThread;
+/* saves the running thread's registers into from and resumes to */
+static void swapThreads(tcb * from, tcb * to) {
+#ifdef USE_FAST_SWITCH
+    fastSwitch(&from->thread_sp, to->thread_sp);
+#else
+    swapcontext(from->thread_context, to->thread_context);
+#endif
+}
 
-//timer for scheduler
-struct itimerval timer;
+static tcb * newIdleBlock() {
+    tcb * idle = calloc(1, sizeof(tcb));
+    idle->thread_context = malloc(sizeof(ucontext_t));
+    idle->thread_state = WAITING;
+    return idle;
+}
 
-// The exit context
-ucontext_t exitContext;
+/* entry point of every kernel worker but the first */
+static void * workerMain(void * arg) {
+    worker * w = arg;
+    myWorker = w;
+    preemptCount = 0;
+    w->ktid = syscall(SYS_gettid);
+    w->slice_start = nowNs();
+    createTimer(w);
+    workerLoop();
+    return NULL;
+}
 
 void init() {
 	firstTimeRunning = 1;
-   
-	//creating exit context
-	getcontext(&exitContext);
-	exitContext.uc_link = 0;
-	exitContext.uc_stack.ss_sp = malloc(STACK_SIZE);
-	exitContext.uc_stack.ss_size = STACK_SIZE;
-	exitContext.uc_stack.ss_flags = 0;
-	void (*exit)(void*) = &my_pthread_exit;  
-    makecontext(&exitContext, (void*) exit, 1, NULL);
-    
-    retQueue = malloc(sizeof(RetQueue));
-	schedQueue = malloc(sizeof(TcbQueue)); 
-	queue2 = malloc(sizeof(TcbQueue));
-	queue2->head = NULL;
-	queue3 = malloc(sizeof(TcbQueue)); 
-	queue3->head = NULL;
-	queue4 = malloc(sizeof(TcbQueue)); 
-    queue4->head = NULL;
-    waitQueue = malloc(sizeof(TcbQueue)); 
+
     
-    tcb * initialBlock = malloc(sizeof(tcb)); 
+    tcb * initialBlock = calloc(1, sizeof(tcb)); 
     initialBlock->thread_context = malloc(sizeof(ucontext_t)); 
     initialBlock->tid = 0;
     initialBlock->run_time = 0;
     initialBlock->priority = 0; 
+    initialBlock->tickets = DEFAULT_TICKETS;
+    initialBlock->thread_state = READY;
+    initialBlock->on_cpu = 1;
     getcontext(initialBlock->thread_context); 
-    currentThread = initialBlock;  
+    ThreadSlot * slot = newSlot(0);
+    slot->state = READY;
+    slot->block = initialBlock;
+    slot->on_cpu = 1;
+
+    if (numWorkers == 0) {
+        numWorkers = defaultWorkers();
+    }
+    if (!mlfqSet) {
+        defaultMlfq();
+    }
+    if (!policySet && getenv("MY_PTHREAD_SCHED") != NULL) {
+        SchedOps * ops = findPolicy(getenv("MY_PTHREAD_SCHED"));
+        if (ops != NULL) {
+            policy = ops;
+        }
+    }
+    if (stackPoolCap < 0) {
+        char * env = getenv("MY_PTHREAD_STACK_POOL");
+        stackPoolCap = env != NULL ? atoi(env) : DEFAULT_STACK_POOL;
+    }
+    int i;
+    for (i = 0; i < numWorkers; i++) {
+        initDeque(&workers[i].fresh);
+    }
+
+    // the calling kernel thread becomes worker 0, its idle loop gets a stack of its own
+    worker * w = &workers[0];
+    w->id = 0;
+    w->ktid = syscall(SYS_gettid);
+    w->kthread = pthread_self();
+    w->current = initialBlock;
+    w->slice_start = nowNs();
+    ThreadStack * st = allocStack(STACK_SIZE, sysconf(_SC_PAGESIZE));
+    w->idle = &st->block;
+    w->idle->stack = st;
+    w->idle->thread_context = &st->context;
+    w->idle->thread_state = WAITING;
+    makeThreadContext(w->idle, stackBottom(st), (char *) st - stackBottom(st), &workerLoop);
+    myWorker = w;
+
+    // installed once for every worker's timer. The handler may switch
+    // threads, which with fastSwitch never restores a blocked mask, so
+    // SIGALRM stays unblocked and preemptCount stops nesting instead.
+    struct sigaction interrupt;
+    memset(&interrupt, 0, sizeof(interrupt));
+    interrupt.sa_handler = &reset_timer; 
+    interrupt.sa_flags = SA_NODEFER | SA_RESTART;
+    sigaction(SIGALRM, &interrupt, NULL); 
+    createTimer(w);
+
+    for (i = 1; i < numWorkers; i++) {
+        w = &workers[i];
+        w->id = i;
+        w->idle = newIdleBlock();
+        w->idle->on_cpu = 1;
+        w->current = w->idle;
+        pthread_create(&w->kthread, NULL, &workerMain, w);
+    }
 }
 
 /* scheduler */
 static void schedule() {
-	
-#ifndef MLFQ
-    sched_stcf();
-#else
-    sched_mlfq();
-#endif
+    preemptDisable();
+    scheduleNext(1);
+}
+
+/* 
+ * runs the policy, requeue is 0 when the current thread is blocking or
+ * exiting and must not go back on a ready queue. Threads that never ran
+ * go first whatever the policy, they are cheap to start and steal.
+ */
+static void scheduleNext(int requeue) {
+    worker * w = myWorker;
+    tcb * oldThread = w->current;
+    tcb * old = oldThread != w->idle ? oldThread : NULL;
+
+    unsigned long long used = chargeSlice(w);
+    tcb * to_run = w->edfHeap.root == NULL ? dequePop(&w->fresh) : NULL;
+
+    spinLock(&w->lock);
+    if (w->sleepers.root != NULL) {
+        wakeSleepers(w, w->slice_start);
+    }
+    policy->on_tick(w, old, used);
+    if (old != NULL && old->edf != NULL) {
+        chargeEdf(old);
+    }
+    if (old != NULL) {
+        if (requeue) {
+            enqueueReady(w, old);
+        } else {
+            policy->on_block(w, old);
+        }
+    }
+    if (w->edfHeap.root != NULL) {
+        // a deadline beats a fresh thread, it goes back for later
+        if (to_run != NULL) {
+            dequePush(&w->fresh, to_run);
+        }
+        to_run = pickNext(w);
+    } else if (to_run == NULL) {
+        to_run = pickNext(w);
+    }
+    spinUnlock(&w->lock);
+
+    if (to_run == NULL) {
+        to_run = stealWork(w);
+    }
+    switchTo(w, to_run, to_run != NULL ? sliceOf(to_run) : 0);
+}
+
+/* 
+ * like scheduleNext(1), but switches to next, already taken off its ready
+ * queue, instead of asking the policy. The caller is charged and requeued
+ * as for any yield, next is charged for what it runs from here.
+ */
+static void scheduleDirect(tcb * next) {
+    worker * w = myWorker;
+    tcb * old = w->current;
+
+    unsigned long long used = chargeSlice(w);
+    spinLock(&w->lock);
+    if (w->sleepers.root != NULL) {
+        wakeSleepers(w, w->slice_start);
+    }
+    policy->on_tick(w, old, used);
+    if (old->edf != NULL) {
+        chargeEdf(old);
+    }
+    enqueueReady(w, old);
+    spinUnlock(&w->lock);
+    switchTo(w, next, sliceOf(next));
 }
 
-void reset_timer() { 
-    getitimer(ITIMER_REAL, &timer); 
-    timer.it_value.tv_usec = 0;
-    setitimer(ITIMER_REAL, &timer, NULL); 
+/* takes t off the ready queues of whichever worker holds it, 0 if it was on none */
+static int takeReady(tcb * t) {
+    for (;;) {
+        worker * w = t->rq;
+        if (w == NULL) {
+            return 0;
+        }
+        spinLock(&w->lock);
+        if (t->rq == w) {
+            if (t->edf != NULL) {
+                removeTcbHeap(t, &w->edfHeap);
+            } else {
+                policy->remove(w, t);
+            }
+            t->rq = NULL;
+            spinUnlock(&w->lock);
+            return 1;
+        }
+        spinUnlock(&w->lock);
+    }
+}
+
+/* blocks the caller on its worker until CLOCK_MONOTONIC reaches wake */
+static void sleepUntil(unsigned long long wake) {
+    preemptDisable();
+    worker * w = myWorker;
+    tcb * me = w->current;
+    spinLock(&w->lock);
+    me->thread_state = WAITING;
+    me->key = wake;
+    insertTcbHeap(me, &w->sleepers);
+    spinUnlock(&w->lock);
+    scheduleNext(0);
+}
+
+/* 
+ * timer tick, preempts the running thread once it has had its slice of cpu.
+ * Inside a preempt-disabled section it only leaves need_resched set for
+ * preemptEnable to act on.
+ */
+void reset_timer(int signum) { 
+    worker * w = myWorker;
+    if (w->current == w->idle) {
+        return;
+    }
+    unsigned long long now = nowNs();
+    // a sleeper coming due may be an EDF thread that should preempt
+    tcb * sleeper = w->sleepers.root;
+    if (!w->need_resched && now < w->slice_end &&
+        (sleeper == NULL || (long long) (sleeper->key - now) > 0)) {
+        return;
+    }
+    w->need_resched = 1;
+    if (preemptCount) {
+        return;
+    }
 	schedule();
 }
 
-/* Preemptive SJF (STCF) scheduling algorithm */
-static void sched_stcf() {
-    struct sigaction interrupt;
-    
-    tcb * oldThread = currentThread;
-    
-	if (oldThread != NULL && oldThread->thread_state != WAITING) {
-		oldThread->run_time += 1;
-		// put the context back into the queue
-		oldThread->thread_state = READY;
-		enqueueTcb(oldThread, schedQueue);
-	}
-    memset(&interrupt, 0, sizeof(interrupt));
-    interrupt.sa_handler = &reset_timer; 
-    sigaction(SIGALRM, &interrupt, NULL); 
+/*
+ * Switches this worker from its current thread to next. A NULL next means
+ * nothing was ready: a runnable thread keeps going, a blocked one hands the
+ * worker back to its idle loop.
+ */
+static void switchTo(worker * w, tcb * next, unsigned long long slice) {
+    tcb * oldThread = w->current;
 
-	tcb * to_run = getSJF(schedQueue); 
-	
-	if ( to_run == NULL ){
-		return; 
-	}
-	removeFromTcbQueue(to_run,schedQueue);
-	
-	timer.it_value.tv_sec = 0; 
-    timer.it_value.tv_usec = RUN_TIME_USEC; 
-	setitimer(ITIMER_REAL, &timer, NULL); 
-		
-    if (oldThread != NULL) {
-        currentThread = to_run; 
-        swapcontext(oldThread->thread_context, to_run->thread_context); 
+    if (next == NULL) {
+        if (oldThread == w->idle) {
+            preemptCount = 0;
+            return;
+        }
+        next = w->idle;
     }
-    else {
-        currentThread = to_run; 
-        setcontext(to_run->thread_context); 
+    // a fresh slice, the tick checks it against the clock
+    w->slice_end = w->slice_start + slice;
+    w->need_resched = 0;
+    if (next == oldThread) {
+        preemptCount = 0;
+        return;
+    }
+
+    // another worker may have queued this thread and still be saving it
+    while (next->on_cpu) {
+        cpuRelax();
     }
+    next->on_cpu = 1;
+    if (next != w->idle) {
+        findSlot(next->tid)->on_cpu = 1;
+    }
+    w->prev = oldThread;
+    w->current = next;
+    swapThreads(oldThread, next);
+    finishSwitch();
 }
 
-static void sched_mlfq() {
-	struct sigaction interrupt;
-    
-    tcb * oldThread = currentThread;
-    
-	if (oldThread != NULL && oldThread->thread_state != WAITING) {
-		// put the context back into the queue
-		oldThread->thread_state = READY;
-		//increment priority if less than 3
-		//determine which queue to add to
-		if(oldThread->priority == 0){
-			oldThread->priority++;
-			enqueueTcb(oldThread, queue2);
-		}else if(oldThread->priority == 1){
-			oldThread->priority++;
-			enqueueTcb(oldThread, queue3);
-		}else{
-			enqueueTcb(oldThread, queue4);
-		}
-	}
-    
-    memset(&interrupt, 0, sizeof(interrupt));
-    interrupt.sa_handler = &reset_timer; 
-    sigaction(SIGALRM, &interrupt, NULL); 
-	
-	int q=-1;
-    tcb * to_run = NULL;  
-    if(schedQueue->head != NULL){
-		q=0;
-		to_run = dequeueTcb(schedQueue);
-	}else if(queue2->head != NULL){
-		q=1;
-		to_run = dequeueTcb(queue2);
-	}else if(queue3->head != NULL){
-		q=2;
-		to_run = dequeueTcb(queue3);
-	}else if(queue4->head != NULL){
-		q=3;
-		to_run = dequeueTcb(queue4);
-	}
-    
-      
-    if ( to_run == NULL || q == -1 ){
-		return; 
-	}
-	
-	timer.it_value.tv_sec = 0; 
-    timer.it_value.tv_usec = RUN_TIME_USEC*(q+1);
-	setitimer(ITIMER_REAL, &timer, NULL); 
-	
-    if (oldThread != NULL) {
-        currentThread = to_run; 
-        swapcontext(oldThread->thread_context, to_run->thread_context); 
+/* 
+ * charges the worker's current thread for the cpu it used since its slice
+ * started and starts the next one, returns the ns charged
+ */
+static unsigned long long chargeSlice(worker * w) {
+    unsigned long long now = nowNs();
+    unsigned long long used = now - w->slice_start;
+    w->slice_start = now;
+    if (w->current == w->idle) {
+        return 0;
+    }
+    w->current->run_time += used;
+    return used;
+}
+
+/* runs on the thread we switched to, possibly on a different worker */
+static void finishSwitch() {
+    worker * w = myWorker;
+    tcb * prev = w->prev;
+    w->prev = NULL;
+    if (prev != NULL) {
+        if (prev->thread_state == FINISHED) {
+            if (prev->stack != NULL) {
+                releaseStack(prev->stack);
+            } else {
+                free(prev->thread_context);
+                free(prev);
+            }
+        } else {
+            if (prev != w->idle) {
+                findSlot(prev->tid)->on_cpu = 0;
+            }
+            __sync_lock_release(&prev->on_cpu);
+        }
+    }
+    // a switch only ever happens under the scheduler's own disable
+    preemptCount = 0;
+}
+
+/* idle loop of a worker, sleeps until some thread is made ready */
+static void workerLoop() {
+    finishSwitch();
+    worker * w = myWorker;
+    for (;;) {
+        __sync_add_and_fetch(&idleWorkers, 1);
+        int seq = wakeSeq;
+        tcb * sleeper = w->sleepers.root;
+        long long wait = 10 * 1000 * 1000;
+        if (sleeper != NULL && (long long) (sleeper->key - nowNs()) < wait) {
+            wait = (long long) (sleeper->key - nowNs());
+        }
+        if (wait > 0 && !anyReady()) {
+            // no point ticking while asleep, our own sleepers set the timeout
+            struct timespec ts = {wait / 1000000000, wait % 1000000000};
+            armTimer(w, 0);
+            syscall(SYS_futex, &wakeSeq, FUTEX_WAIT_PRIVATE, seq, &ts, NULL, 0);
+            armTimer(w, 1);
+        }
+        __sync_sub_and_fetch(&idleWorkers, 1);
+        schedule();
+    }
+}
+
+/* first code a new thread runs */
+static void threadStart() {
+    finishSwitch();
+    tcb * me = self();
+    my_pthread_exit(me->function(me->arg));
+}
+
+/* 
+ * Preemptive SJF (STCF): the heap is keyed on cpu used so far, so the
+ * thread that has run the least goes next.
+ */
+static tcb * stcfPickNext(worker * w) {
+    return popTcbHeap(&w->readyHeap);
+}
+
+static void stcfEnqueue(worker * w, tcb * t) {
+    t->key = effectiveRank(t, t->run_time);
+    insertTcbHeap(t, &w->readyHeap);
+}
+
+static void stcfOnTick(worker * w, tcb * t, unsigned long long used) {
+}
+
+static void stcfOnBlock(worker * w, tcb * t) {
+}
+
+static void stcfOnWake(worker * w, tcb * t) {
+}
+
+static unsigned long long stcfSlice(tcb * t) {
+    return RUN_TIME_USEC * 1000ULL;
+}
+
+static unsigned long long stcfRank(tcb * t) {
+    return t->run_time;
+}
+
+/* STCF and stride both keep their ready threads in the heap */
+static void heapRemove(worker * w, tcb * t) {
+    removeTcbHeap(t, &w->readyHeap);
+}
+
+/* 
+ * moves every ready thread on this worker back to the top level with a
+ * fresh allotment, w->lock must be held. Blocked threads keep their level
+ * and get caught by a later boost once they are ready again.
+ */
+static void boostQueues(worker * w) {
+    int q;
+    TcbQueue * top = &w->readyQueues[0];
+    for (q = 0; q < mlfq.levels; q++) {
+        TcbQueue * queue = &w->readyQueues[q];
+        tcb * ptr;
+        for (ptr = queue->head; ptr != NULL; ptr = ptr->next) {
+            ptr->priority = 0;
+            ptr->allot_used = 0;
+        }
+        if (q == 0 || queue->head == NULL) {
+            continue;
+        }
+        if (top->head == NULL) {
+            top->head = queue->head;
+        } else {
+            top->tail->next = queue->head;
+        }
+        top->tail = queue->tail;
+        queue->head = NULL;
+        queue->tail = NULL;
+    }
+}
+
+/* 
+ * MLFQ: a thread drops a level once it has used that level's allotment,
+ * however many slices that took, so yielding just before the tick doesn't
+ * keep a cpu hog on top. The periodic boost stops the lower levels from
+ * starving.
+ */
+static tcb * mlfqPickNext(worker * w) {
+    int q;
+    for (q = 0; q < mlfq.levels; q++) {
+        if (w->readyQueues[q].head != NULL) {
+            return dequeueTcb(&w->readyQueues[q]);
+        }
+    }
+    return NULL;
+}
+
+static void mlfqEnqueue(worker * w, tcb * t) {
+    enqueueTcb(t, &w->readyQueues[effectiveRank(t, levelOf(t))]);
+}
+
+static void mlfqOnTick(worker * w, tcb * t, unsigned long long used) {
+    if (t != NULL) {
+        int level = levelOf(t);
+        t->allot_used += used;
+        if (t->allot_used >= mlfq.allot_usec[level] * 1000ULL && level < mlfq.levels - 1) {
+            t->priority = level + 1;
+            t->allot_used = 0;
+        }
+    }
+    if (mlfq.boost_usec != 0 && w->slice_start >= w->next_boost) {
+        boostQueues(w);
+        if (t != NULL) {
+            t->priority = 0;
+            t->allot_used = 0;
+        }
+        w->next_boost = w->slice_start + mlfq.boost_usec * 1000ULL;
+    }
+}
+
+static void mlfqOnBlock(worker * w, tcb * t) {
+}
+
+static void mlfqOnWake(worker * w, tcb * t) {
+}
+
+static unsigned long long mlfqSlice(tcb * t) {
+    return mlfq.quantum_usec[levelOf(t)] * 1000ULL;
+}
+
+static unsigned long long mlfqRank(tcb * t) {
+    return levelOf(t);
+}
+
+static void mlfqRemove(worker * w, tcb * t) {
+    int q;
+    for (q = 0; q < mlfq.levels; q++) {
+        tcb * ptr;
+        for (ptr = w->readyQueues[q].head; ptr != NULL; ptr = ptr->next) {
+            if (ptr == t) {
+                removeFromTcbQueue(t, &w->readyQueues[q]);
+                return;
+            }
+        }
+    }
+}
+
+/* 
+ * Stride: each thread's pass moves by the cpu it used divided by its
+ * tickets and the smallest pass runs next, so over time every thread gets
+ * cpu in proportion to its tickets. Shares hold per worker, threads only
+ * move between workers when one runs dry.
+ */
+static tcb * stridePickNext(worker * w) {
+    tcb * t = popTcbHeap(&w->readyHeap);
+    if (t != NULL) {
+        w->vtime = t->pass;
+    }
+    return t;
+}
+
+static void strideEnqueue(worker * w, tcb * t) {
+    // new, woken and stolen threads don't get to cash in time they weren't here
+    if ((long long) (t->pass - w->vtime) < 0) {
+        t->pass = w->vtime;
+    }
+    t->key = effectiveRank(t, t->pass);
+    insertTcbHeap(t, &w->readyHeap);
+}
+
+static void strideOnTick(worker * w, tcb * t, unsigned long long used) {
+    if (t != NULL) {
+        // multiply first, a stride of STRIDE1 / tickets rounds every count
+        // above STRIDE1 / 2 down to the same 1
+        t->pass += used * STRIDE1 / t->tickets;
+    }
+}
+
+static void strideOnBlock(worker * w, tcb * t) {
+}
+
+static void strideOnWake(worker * w, tcb * t) {
+}
+
+static unsigned long long strideSlice(tcb * t) {
+    return RUN_TIME_USEC * 1000ULL;
+}
+
+static unsigned long long strideRank(tcb * t) {
+    return t->pass;
+}
+
+/* 
+ * a new thread joins at the worker's virtual time plus part of the stride
+ * a slice costs it, picked from its tid. Threads created together would
+ * otherwise keep running back to back every round, and a share measured
+ * over a few rounds would swing with where the window cuts them.
+ */
+static void strideJoin(worker * w, tcb * t) {
+    unsigned long long stride = strideSlice(t) * STRIDE1 / t->tickets;
+    t->pass = w->vtime + ((t->tid * 2654435761u) >> 16) * stride / 65536;
+}
+
+SchedOps stcfOps = {"stcf", stcfPickNext, stcfEnqueue, stcfOnTick, stcfOnBlock, stcfOnWake, stcfSlice,
+                    stcfRank, heapRemove};
+SchedOps mlfqOps = {"mlfq", mlfqPickNext, mlfqEnqueue, mlfqOnTick, mlfqOnBlock, mlfqOnWake, mlfqSlice,
+                    mlfqRank, mlfqRemove};
+SchedOps strideOps = {"stride", stridePickNext, strideEnqueue, strideOnTick, strideOnBlock,
+                      strideOnWake, strideSlice, strideRank, heapRemove};
+
+/* policies my_pthread_setpolicy and MY_PTHREAD_SCHED can pick */
+static SchedOps * policies[] = {&stcfOps, &mlfqOps, &strideOps};
+
+static SchedOps * findPolicy(const char * name) {
+    int i;
+    // the Makefile calls STCF PSJF
+    if (strcmp(name, "psjf") == 0) {
+        name = "stcf";
+    }
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        if (strcmp(policies[i]->name, name) == 0) {
+            return policies[i];
+        }
+    }
+    return NULL;
+}
+
+/* gives back the utilization an EDF thread reserved */
+static void leaveEdf(EdfState * edf) {
+    // exit takes edfLock too, a holder preempted on its worker would leave it spinning
+    preemptDisable();
+    spinLock(&edfLock);
+    if (edf->admitted) {
+        edfUtil -= edf->runtime * 1000000 / edf->period;
+        edf->admitted = 0;
+    }
+    spinUnlock(&edfLock);
+    preemptEnable();
+}
+
+/* create a new thread */
+int my_pthread_create(my_pthread_t *thread, my_pthread_attr_t *attr,
+                      void *(*function)(void *), void *arg) {
+    return my_pthread_create_n(thread, 1, attr, function, &arg);
+};
+
+/* 
+ * creates n threads, the i-th runs function(args[i]) or function(NULL)
+ * without args. The stacks the pool can't give come from one mapping, and
+ * the threads all go on this worker's deque, in order, before the one yield
+ * that lets them start.
+ */
+int my_pthread_create_n(my_pthread_t *threads, int n, my_pthread_attr_t *attr,
+                        void *(*function)(void *), void **args) {
+	if (firstTimeRunning == 0) {
+		init();
+	}
+    if (n <= 0) {
+        return n == 0 ? 0 : -1;
+    }
+	preemptDisable();
+
+    // The stack comes with room for the tcb and context at its top
+    size_t stacksize = STACK_SIZE;
+    size_t guardsize = sysconf(_SC_PAGESIZE);
+    unsigned int tickets = DEFAULT_TICKETS;
+    int yield = 1;
+    int joinable = 1;
+    if (attr != NULL) {
+        stacksize = attr->stacksize;
+        guardsize = attr->guardsize;
+        tickets = attr->tickets;
+        yield = attr->yield;
+        joinable = attr->detachstate != MY_PTHREAD_CREATE_DETACHED;
+    }
+    ThreadStack * one;
+    ThreadStack ** stacks = n == 1 ? &one : malloc(n * sizeof(ThreadStack *));
+    if (stacks == NULL || allocStacks(stacks, n, stacksize, guardsize) != 0) {
+        if (stacks != &one) {
+            free(stacks);
+        }
+        preemptEnable();
+        return -1;
+    }
+
+    // recycled tids first, new ones for the rest
+    int i = 0;
+    spinLock(&slotLock);
+    while (i < n && freeTids != 0) {
+        threads[i] = freeTids;
+        freeTids = findSlot(freeTids)->next_free;
+        i++;
+    }
+    spinUnlock(&slotLock);
+    if (i < n) {
+        my_pthread_t first = __sync_fetch_and_add(&tids, n - i) + 1;
+        int j;
+        for (j = i; j < n; j++) {
+            threads[j] = first + j - i;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        ThreadStack * st = stacks[i];
+
+        // Create a thread control block for this new thread
+        tcb * newBlock = &st->block; 
+        memset(newBlock, 0, sizeof(tcb));
+        newBlock->stack = st;
+        newBlock->thread_context = &st->context; 
+
+        // Make the context for this new thread
+        makeThreadContext(newBlock, stackBottom(st), (char *) st - stackBottom(st), &threadStart);
+        newBlock->run_time = 0; 
+        newBlock->priority = 0;
+        newBlock->thread_state = READY;
+        newBlock->on_cpu = 0;
+        newBlock->handoff = 0;
+        newBlock->function = function;
+        newBlock->arg = args != NULL ? args[i] : NULL;
+        newBlock->tickets = tickets;
+        newBlock->tid = threads[i];  
+        strideJoin(myWorker, newBlock);
+        // a stale getter may still hold the slot of a recycled tid
+        ThreadSlot * slot = newSlot(threads[i]);
+        spinLock(&slot->lock);
+        slot->state = READY;
+        slot->block = newBlock;
+        slot->joiners = NULL;
+        slot->returnVal = NULL;
+        slot->run_time = 0;
+        slot->edf = NULL;
+        slot->joinable = joinable;
+        slot->joining = 0;
+        spinUnlock(&slot->lock);
+    }
+    // Add the new blocks to this worker's deque, idle workers steal from it.
+    // The owner pops the newest first, so push in reverse to start them in order
+    for (i = n - 1; i >= 0; i--) {
+        dequePush(&myWorker->fresh, &stacks[i]->block);
+    }
+    if (stacks != &one) {
+        free(stacks);
+    }
+    for (i = 0; i < n && i < numWorkers; i++) {
+        wakeWorker();
+    }
+    preemptEnable();
+
+    // Call my pthread_yield to begin scheduling
+    if (yield) {
+        my_pthread_yield(); 
+    }
+    
+    return 0;
+};
+
+/* give CPU pocession to other user level threads voluntarily */
+int my_pthread_yield() {
+    schedule();
+    return 0;
+};
+
+/* 
+ * gives the rest of the caller's turn straight to thread, skipping the
+ * policy. Only a thread waiting on a ready queue can be switched to, for
+ * anything else (running, blocked, not started yet) this is a plain yield
+ * and returns -1.
+ */
+int my_pthread_yield_to(my_pthread_t thread) {
+    tcb * me = self();
+    if (thread > tids || thread == me->tid) {
+        my_pthread_yield();
+        return -1;
+    }
+    ThreadSlot * slot = findSlot(thread);
+    preemptDisable();
+    // holding the slot keeps a target that is about to run from exiting under us.
+    // One still being saved by another worker would only have us spin on it
+    spinLock(&slot->lock);
+    tcb * target = slot->block;
+    int taken = target != NULL && !target->on_cpu && takeReady(target);
+    spinUnlock(&slot->lock);
+    if (!taken) {
+        preemptEnable();
+        my_pthread_yield();
+        return -1;
+    }
+    scheduleDirect(target);
+    return 0;
+}
+
+/* terminate a thread */
+void my_pthread_exit(void *value_ptr) {
+    preemptDisable();
+    tcb * me = myWorker->current;
+    ThreadSlot * slot = findSlot(me->tid);
+
+    if (me->edf != NULL) {
+        leaveEdf(me->edf);
+        me->edf = NULL;
+    }
+
+    // Leave the return value in the table and take every waiting joiner
+    unsigned long long used = me->run_time + (nowNs() - myWorker->slice_start);
+    spinLock(&slot->lock);
+    slot->returnVal = value_ptr;
+    slot->run_time = used;
+    slot->state = FINISHED;
+    slot->block = NULL;
+    slot->on_cpu = 0;
+    tcb * ptr = slot->joiners;
+    slot->joiners = NULL;
+    int detached = !slot->joinable;
+    spinUnlock(&slot->lock);
+
+    // nobody will ever read what a detached thread left behind
+    if (detached) {
+        recycleSlot(me->tid, slot);
+    }
+
+    // Put the joiners onto the scheduling queue
+    while (ptr != NULL) {
+        tcb * next = ptr->next;
+        readyTcb(ptr);
+        ptr = next;
+    }
+
+    // the next thread to run frees our stack once we're off it
+    me->thread_state = FINISHED;
+    scheduleNext(0);
+};
+
+/* wait for thread termination */
+int my_pthread_join(my_pthread_t thread, void **value_ptr) {
+    if (thread == 0 || thread > tids) {
+        return -1;
+    }
+    preemptDisable();
+    ThreadSlot * slot = findSlot(thread);
+    spinLock(&slot->lock);
+    if (!slot->joinable) {
+        spinUnlock(&slot->lock);
+        preemptEnable();
+        return -1;
+    }
+    slot->joining++;
+    
+    if (slot->state != FINISHED) {
+        tcb * me = myWorker->current;
+        me->thread_state = WAITING; 
+        me->next = slot->joiners;
+        slot->joiners = me;
+        spinUnlock(&slot->lock);
+        scheduleNext(0);
+
+        // exit only wakes us after the return value is in place
+        preemptDisable();
+        spinLock(&slot->lock);
+    }
+    
+    if (value_ptr != NULL) {
+		*value_ptr = slot->returnVal;
+	}
+    // the last joiner out gives the slot back
+    int last = --slot->joining == 0;
+    if (last) {
+        slot->joinable = 0;
+    }
+	spinUnlock(&slot->lock);
+    if (last) {
+        recycleSlot(thread, slot);
+    }
+	preemptEnable();
+	
+    return 0;
+}
+
+/* nobody will join thread, its slot is freed as soon as it exits */
+int my_pthread_detach(my_pthread_t thread) {
+    self();
+    if (thread == 0 || thread > tids) {
+        return -1;
+    }
+    preemptDisable();
+    ThreadSlot * slot = findSlot(thread);
+    spinLock(&slot->lock);
+    // a thread someone is already joining stays theirs
+    if (!slot->joinable || slot->joining > 0) {
+        spinUnlock(&slot->lock);
+        preemptEnable();
+        return -1;
+    }
+    slot->joinable = 0;
+    int finished = slot->state == FINISHED;
+    spinUnlock(&slot->lock);
+    if (finished) {
+        recycleSlot(thread, slot);
+    }
+    preemptEnable();
+    return 0;
+}
+
+/* 
+ * frees what the slot of an exited thread nobody can join any more still
+ * holds and puts its tid up for the next create
+ */
+static void recycleSlot(my_pthread_t tid, ThreadSlot * slot) {
+    // getters read edf under the slot lock
+    spinLock(&slot->lock);
+    EdfState * edf = slot->edf;
+    slot->edf = NULL;
+    spinUnlock(&slot->lock);
+    free(edf);
+    spinLock(&slotLock);
+    slot->next_free = freeTids;
+    freeTids = tid;
+    spinUnlock(&slotLock);
+}
+
+/* 
+ * whether the slot still belongs to a thread: running, or exited and not
+ * joined yet. Called under the slot lock
+ */
+static int slotLive(ThreadSlot * slot) {
+    return slot->block != NULL || slot->joinable;
+}
+
+/* slot of a tid that has been handed out, O(1) */
+ThreadSlot * findSlot(my_pthread_t tid) {
+    ThreadSlot * chunk = __atomic_load_n(&slotChunks[tid / SLOT_CHUNK], __ATOMIC_ACQUIRE);
+    return chunk != NULL ? &chunk[tid % SLOT_CHUNK] : NULL;
+}
+
+/* initialize the mutex lock */
+int my_pthread_mutex_init(my_pthread_mutex_t *mutex,
+                          const my_pthread_mutexattr_t *mutexattr) {
+    if (mutex->initialized == 1) {
+        return -1;
+    }
+    mutex->lock = MUTEX_FREE;
+    mutex->initialized = 1;
+    mutex->tid = -1;
+    mutex->destroyed = 0;
+    mutex->guard = 0;
+    mutex->waiters.head = NULL;
+    mutex->waiters.tail = NULL;
+    mutex->owner = NULL;
+    mutex->next_held = NULL;
+    mutex->spin = mutexattr != NULL ? mutexattr->spin : DEFAULT_MUTEX_SPIN;
+    mutex->spin_acquires = 0;
+    mutex->parks = 0;
+    return 0;
+};
+
+/* records a mutex as held by its new owner */
+static void pushHeld(tcb * me, my_pthread_mutex_t * mutex) {
+    mutex->next_held = me->held;
+    me->held = mutex;
+}
+
+static void popHeld(tcb * me, my_pthread_mutex_t * mutex) {
+    my_pthread_mutex_t ** ptr = &me->held;
+    while (*ptr != NULL && *ptr != mutex) {
+        ptr = &(*ptr)->next_held;
+    }
+    if (*ptr != NULL) {
+        *ptr = mutex->next_held;
+    }
+    mutex->next_held = NULL;
+}
+
+/* best rank among the threads parked on the mutex, called under its guard */
+static int bestWaiterRank(my_pthread_mutex_t * mutex, unsigned long long * best_rank) {
+    int found = 0;
+    tcb * ptr;
+    for (ptr = mutex->waiters.head; ptr != NULL; ptr = ptr->next) {
+        if (ptr->edf == NULL) {
+            unsigned long long rank = effectiveRank(ptr, policy->rank(ptr));
+            if (!found || rankBefore(rank, *best_rank)) {
+                *best_rank = rank;
+                found = 1;
+            }
+        }
+    }
+    return found;
+}
+
+/* 
+ * after an unlock, falls back to the rank lent by the waiters of the mutexes
+ * still held. Their guards stay taken until the new rank is in, so a waiter
+ * parking meanwhile can't have its boost overwritten
+ */
+static void dropInheritedRank(tcb * me) {
+    if (!me->pi_boosted) {
+        return;
+    }
+    my_pthread_mutex_t * m;
+    unsigned long long best_rank = 0;
+    int boosted = 0;
+    for (m = me->held; m != NULL; m = m->next_held) {
+        unsigned long long rank;
+        spinLock(&m->guard);
+        if (bestWaiterRank(m, &rank) && (!boosted || rankBefore(rank, best_rank))) {
+            best_rank = rank;
+            boosted = 1;
+        }
+    }
+    me->pi_rank = best_rank;
+    me->pi_boosted = boosted;
+    for (m = me->held; m != NULL; m = m->next_held) {
+        spinUnlock(&m->guard);
+    }
+}
+
+/* 
+ * spins on a contended lock while its owner is running on another worker
+ * and so should let go soon, gives up once the budget is gone or the owner
+ * is off cpu
+ */
+static int spinAcquire(my_pthread_mutex_t *mutex) {
+    int budget = mutex->spin;
+    while (budget-- > 0) {
+        if (mutex->lock == MUTEX_FREE) {
+            if (__sync_bool_compare_and_swap(&mutex->lock, MUTEX_FREE, MUTEX_LOCKED)) {
+                __sync_fetch_and_add(&mutex->spin_acquires, 1);
+                return 1;
+            }
+            continue;
+        }
+        // the owner can exit and its stack go away under us, its slot can't.
+        // A reused tid only costs a few more rounds of the budget
+        my_pthread_t tid = __atomic_load_n(&mutex->tid, __ATOMIC_RELAXED);
+        if (tid > tids || !findSlot(tid)->on_cpu) {
+            return 0;
+        }
+        cpuRelax();
+    }
+    return 0;
+}
+
+/* 
+ * parks the caller on the mutex. A woken waiter has to take the lock like
+ * anyone else, which keeps the owner from convoying behind every waiter it
+ * wakes; one that loses it goes back on the front and gets it handed over.
+ */
+static void lockContended(my_pthread_mutex_t *mutex) {
+    preemptDisable();
+    tcb * me = myWorker->current;
+    int woken = 0;
+    spinLock(&mutex->guard);
+    for (;;) {
+        unsigned int state = mutex->lock;
+        if (state == MUTEX_FREE) {
+            // whoever holds it while others are parked has to wake one on unlock
+            unsigned int locked = mutex->waiters.head != NULL ? MUTEX_CONTENDED : MUTEX_LOCKED;
+            if (__sync_bool_compare_and_swap(&mutex->lock, MUTEX_FREE, locked)) {
+                mutex->tid = me->tid;
+                mutex->owner = me;
+                pushHeld(me, mutex);
+                spinUnlock(&mutex->guard);
+                preemptEnable();
+                return;
+            }
+            continue;
+        }
+        if (state == MUTEX_LOCKED &&
+            !__sync_bool_compare_and_swap(&mutex->lock, MUTEX_LOCKED, MUTEX_CONTENDED)) {
+            continue;
+        }
+
+        mutex->parks++;
+        me->thread_state = WAITING;
+        // the owner runs at least as soon as we would have, so it gets out of our
+        // way. Unlock clears owner before it can free a contended lock and takes
+        // the guard before dropping the boost, so under the guard this is still
+        // the holder and the boost can't outlive its hold
+        tcb * owner = mutex->owner;
+        if (owner != NULL && me->edf == NULL) {
+            inheritRank(owner, effectiveRank(me, policy->rank(me)));
+        }
+        if (woken) {
+            me->handoff = 1;
+            me->next = mutex->waiters.head;
+            mutex->waiters.head = me;
+            if (me->next == NULL) {
+                mutex->waiters.tail = me;
+            }
+        } else {
+            enqueueTcb(me, &mutex->waiters);
+        }
+        spinUnlock(&mutex->guard);
+        scheduleNext(0);
+
+        if (mutex->tid == me->tid) {
+            // handed over by unlock
+            pushHeld(me, mutex);
+            return;
+        }
+        woken = 1;
+        preemptDisable();
+        spinLock(&mutex->guard);
+    }
+}
+
+/* aquire the mutex lock */
+int my_pthread_mutex_lock(my_pthread_mutex_t *mutex) {
+	if (mutex->destroyed == 1) {
+        return -1; 
+    }
+
+    if (__sync_bool_compare_and_swap(&mutex->lock, MUTEX_FREE, MUTEX_LOCKED) ||
+        spinAcquire(mutex)) {
+        tcb * me = self();
+        mutex->tid = me->tid; 
+        mutex->owner = me;
+        pushHeld(me, mutex);
+    } else {
+        lockContended(mutex);
+    }
+    return 0;
+};
+
+/* release the mutex lock */
+int my_pthread_mutex_unlock(my_pthread_mutex_t *mutex) {	
+    tcb * me = self();
+	if (mutex->destroyed == 1 || mutex->tid != me->tid) {
+        return -1; 
+    }
+
+    popHeld(me, mutex);
+    mutex->tid = -1; 
+    mutex->owner = NULL;
+    // nobody parked, so nobody lent us a rank through this one
+    if (__sync_bool_compare_and_swap(&mutex->lock, MUTEX_LOCKED, MUTEX_FREE)) {
+        return 0;
+    }
+
+    // someone is parked, wake the first one
+    preemptDisable();
+    spinLock(&mutex->guard);
+    tcb * next = dequeueTcb(&mutex->waiters);
+    if (next == NULL) {
+        mutex->lock = MUTEX_FREE;
+    } else if (next->handoff) {
+        // it already lost the lock once, pass it over without freeing it
+        next->handoff = 0;
+        mutex->tid = next->tid;
+        mutex->owner = next;
+        mutex->lock = mutex->waiters.head != NULL ? MUTEX_CONTENDED : MUTEX_LOCKED;
+        // the new owner takes over the boost from whoever is still parked
+        unsigned long long best_rank;
+        if (bestWaiterRank(mutex, &best_rank)) {
+            inheritRank(next, best_rank);
+        }
+    } else {
+        mutex->lock = MUTEX_FREE;
+    }
+    spinUnlock(&mutex->guard);
+    // drop what this mutex's waiters lent us, keep what the others still lend
+    dropInheritedRank(me);
+    if (next != NULL) {
+        readyTcb(next);
+    }
+    preemptEnable();
+    return 0;
+};
+
+
+/* destroy the mutex */
+int my_pthread_mutex_destroy(my_pthread_mutex_t *mutex) {
+	if (mutex->lock != MUTEX_FREE || mutex->destroyed == 1) {
+        return -1; 
+    }
+
+    mutex->destroyed = 1; 
+    mutex->tid = -1; 
+    mutex->initialized = 0;
+    return 0; 
+};
+
+/* read how often contended acquires spun their way in or parked */
+int my_pthread_mutex_getstats(my_pthread_mutex_t *mutex, unsigned long *spin_acquires,
+                              unsigned long *parks) {
+    if (spin_acquires != NULL) {
+        *spin_acquires = mutex->spin_acquires;
+    }
+    if (parks != NULL) {
+        *parks = mutex->parks;
+    }
+    return 0;
+}
+
+/* initialize mutex attributes to the defaults */
+int my_pthread_mutexattr_init(my_pthread_mutexattr_t *attr) {
+    attr->spin = DEFAULT_MUTEX_SPIN;
+    return 0;
+}
+
+/* destroy mutex attributes */
+int my_pthread_mutexattr_destroy(my_pthread_mutexattr_t *attr) {
+    return 0;
+}
+
+/* set how many times a contended lock spins before it parks */
+int my_pthread_mutexattr_setspin(my_pthread_mutexattr_t *attr, int spin) {
+    if (spin < 0) {
+        return -1;
+    }
+    attr->spin = spin;
+    return 0;
+}
+
+/* get the spin budget */
+int my_pthread_mutexattr_getspin(const my_pthread_mutexattr_t *attr, int *spin) {
+    *spin = attr->spin;
+    return 0;
+}
+
+/* initialize a condition variable */
+int my_pthread_cond_init(my_pthread_cond_t *cond, const my_pthread_condattr_t *condattr) {
+    if (cond->initialized == 1) {
+        return -1;
+    }
+    cond->initialized = 1;
+    cond->guard = 0;
+    cond->waiters.head = NULL;
+    cond->waiters.tail = NULL;
+    return 0;
+}
+
+/* appends a waiter to cond, cond->guard must be held */
+static void condEnqueue(my_pthread_cond_t *cond, tcb * t) {
+    t->cond = cond;
+    t->cond_next = NULL;
+    if (cond->waiters.head == NULL) {
+        cond->waiters.head = t;
+    } else {
+        cond->waiters.tail->cond_next = t;
+    }
+    cond->waiters.tail = t;
+}
+
+/* takes the first waiter off cond, cond->guard must be held */
+static tcb * condDequeue(my_pthread_cond_t *cond) {
+    tcb * t = cond->waiters.head;
+    if (t != NULL) {
+        cond->waiters.head = t->cond_next;
+        t->cond = NULL;
+    }
+    return t;
+}
+
+/* takes a timed out waiter off cond if a signal hasn't, cond->guard must be held */
+static void condRemove(my_pthread_cond_t *cond, tcb * t) {
+    if (t->cond != cond) {
+        return;
+    }
+    tcb * prev = NULL;
+    tcb * ptr = cond->waiters.head;
+    while (ptr != t) {
+        prev = ptr;
+        ptr = ptr->cond_next;
+    }
+    if (prev == NULL) {
+        cond->waiters.head = t->cond_next;
+    } else {
+        prev->cond_next = t->cond_next;
+    }
+    if (cond->waiters.tail == t) {
+        cond->waiters.tail = prev;
+    }
+    t->cond = NULL;
+}
+
+/* 
+ * parks the caller on cond and releases mutex. wake is the CLOCK_MONOTONIC
+ * ns a timed wait gives up at, 0 waits until signalled. A timed waiter is
+ * on its worker's sleepers before a signal can find it on cond, so the
+ * signal always knows where to take it off.
+ */
+static int condWait(my_pthread_cond_t *cond, my_pthread_mutex_t *mutex, unsigned long long wake) {
+    tcb * me = self();
+    if (cond->initialized != 1 || mutex->tid != me->tid) {
+        return -1;
+    }
+
+    preemptDisable();
+    worker * w = myWorker;
+    me->cond_wait = COND_WAITING;
+    me->thread_state = WAITING;
+    if (wake != 0) {
+        spinLock(&w->lock);
+        me->key = wake;
+        insertTcbHeap(me, &w->sleepers);
+        me->sleeping_on = w;
+        spinUnlock(&w->lock);
+    }
+    spinLock(&cond->guard);
+    condEnqueue(cond, me);
+    spinUnlock(&cond->guard);
+    my_pthread_mutex_unlock(mutex);
+    scheduleNext(0);
+
+    int ret = 0;
+    if (me->cond_wait == COND_TIMEDOUT) {
+        // nobody took us off cond, unless a signal got there after the timeout
+        preemptDisable();
+        spinLock(&cond->guard);
+        condRemove(cond, me);
+        spinUnlock(&cond->guard);
+        preemptEnable();
+        ret = ETIMEDOUT;
+    }
+    me->cond_wait = COND_NONE;
+    my_pthread_mutex_lock(mutex);
+    return ret;
+}
+
+/* wait on the condition variable */
+int my_pthread_cond_wait(my_pthread_cond_t *cond, my_pthread_mutex_t *mutex) {
+    return condWait(cond, mutex, 0);
+}
+
+/* wait on the condition variable until abstime */
+int my_pthread_cond_timedwait(my_pthread_cond_t *cond, my_pthread_mutex_t *mutex,
+                              const struct timespec *abstime) {
+    // abstime is on the wall clock like pthread's, the sleepers run on CLOCK_MONOTONIC
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long left = (long long) (abstime->tv_sec - now.tv_sec) * 1000000000LL +
+                     (abstime->tv_nsec - now.tv_nsec);
+    return condWait(cond, mutex, nowNs() + (left > 0 ? left : 0));
+}
+
+/* 
+ * takes cond's waiters off it, all of them or just the first whose wakeup
+ * a timeout hasn't claimed, and appends them to woken. cond->guard must be
+ * held.
+ */
+static void claimWaiters(my_pthread_cond_t *cond, TcbQueue * woken, int all) {
+    tcb * t;
+    while ((t = condDequeue(cond)) != NULL) {
+        if (__sync_bool_compare_and_swap(&t->cond_wait, COND_WAITING, COND_SIGNALLED)) {
+            enqueueTcb(t, woken);
+            if (!all) {
+                return;
+            }
+        }
+    }
+}
+
+/* 
+ * moves woken waiters, linked through next, straight onto this worker's
+ * ready queues with one lock for the whole batch. Timed condition waiters
+ * come off their worker's sleepers first.
+ */
+static void readyWaiters(tcb * list) {
+    tcb * t;
+    int n = 0;
+    for (t = list; t != NULL; t = t->next) {
+        worker * sw = t->sleeping_on;
+        if (sw != NULL) {
+            spinLock(&sw->lock);
+            if (t->sleeping_on == sw) {
+                removeTcbHeap(t, &sw->sleepers);
+                t->sleeping_on = NULL;
+            }
+            spinUnlock(&sw->lock);
+        }
+    }
+
+    worker * w = myWorker;
+    spinLock(&w->lock);
+    while (list != NULL) {
+        t = list;
+        list = t->next;
+        t->thread_state = READY;
+        policy->on_wake(w, t);
+        enqueueReady(w, t);
+        n++;
+    }
+    spinUnlock(&w->lock);
+    // idle workers steal the rest once they are up
+    if (n > numWorkers) {
+        n = numWorkers;
+    }
+    while (n-- > 0) {
+        wakeWorker();
+    }
+}
+
+/* 
+ * wakes one or every waiter. Waiters queue themselves before they let go
+ * of the mutex, so a signaller holding it can skip the guard when there
+ * are none.
+ */
+static int condWake(my_pthread_cond_t *cond, int all) {
+    if (cond->initialized != 1) {
+        return -1;
+    }
+    if (cond->waiters.head == NULL) {
+        return 0;
+    }
+    TcbQueue woken = {NULL, NULL};
+    preemptDisable();
+    spinLock(&cond->guard);
+    claimWaiters(cond, &woken, all);
+    spinUnlock(&cond->guard);
+    if (woken.head != NULL) {
+        readyWaiters(woken.head);
+    }
+    preemptEnable();
+    return 0;
+}
+
+/* wake one thread waiting on the condition variable */
+int my_pthread_cond_signal(my_pthread_cond_t *cond) {
+    return condWake(cond, 0);
+}
+
+/* wake every thread waiting on the condition variable */
+int my_pthread_cond_broadcast(my_pthread_cond_t *cond) {
+    return condWake(cond, 1);
+}
+
+/* destroy the condition variable */
+int my_pthread_cond_destroy(my_pthread_cond_t *cond) {
+    if (cond->initialized != 1 || cond->waiters.head != NULL) {
+        return -1;
+    }
+    cond->initialized = 0;
+    return 0;
+}
+
+/* initialize the reader-writer lock */
+int my_pthread_rwlock_init(my_pthread_rwlock_t *rwlock, const my_pthread_rwlockattr_t *rwlockattr) {
+    if (rwlock->initialized == 1) {
+        return -1;
+    }
+    rwlock->state = 0;
+    rwlock->initialized = 1;
+    rwlock->prefer_writer = rwlockattr != NULL ? rwlockattr->prefer_writer : 1;
+    rwlock->writer = -1;
+    rwlock->guard = 0;
+    rwlock->readers.head = NULL;
+    rwlock->readers.tail = NULL;
+    rwlock->writers.head = NULL;
+    rwlock->writers.tail = NULL;
+    rwlock->writers_waiting = 0;
+    return 0;
+}
+
+/* 
+ * the acquire path once someone is parked or the lock is taken: tries
+ * under the guard, then parks unless park is 0. Like a mutex waiter, a
+ * woken thread takes the lock like anyone else, so the releaser can come
+ * straight back instead of convoying behind everyone it woke; one that
+ * loses goes back on the front.
+ */
+static int rwlockContended(my_pthread_rwlock_t *rwlock, int write, int park) {
+    preemptDisable();
+    tcb * me = myWorker->current;
+    int woken = 0;
+    spinLock(&rwlock->guard);
+    for (;;) {
+        unsigned int state = rwlock->state;
+        int free = write ? (state & ~RW_WAITERS) == 0 :
+                   !(state & RW_WRITER) && !(rwlock->prefer_writer && rwlock->writers_waiting > 0);
+        if (free) {
+            if (!__sync_bool_compare_and_swap(&rwlock->state, state, write ? state | RW_WRITER : state + 1)) {
+                continue;
+            }
+            if (write) {
+                rwlock->writer = me->tid;
+                if (woken) {
+                    rwlock->writers_waiting--;
+                }
+            }
+            if (rwlock->writers_waiting == 0 && rwlock->readers.head == NULL && rwlock->writers.head == NULL) {
+                __sync_fetch_and_and(&rwlock->state, ~RW_WAITERS);
+            }
+            spinUnlock(&rwlock->guard);
+            preemptEnable();
+            return 0;
+        }
+        if (!park) {
+            spinUnlock(&rwlock->guard);
+            preemptEnable();
+            return EBUSY;
+        }
+        // from here on releases come through the guard and find us
+        if (!(state & RW_WAITERS) && !__sync_bool_compare_and_swap(&rwlock->state, state, state | RW_WAITERS)) {
+            continue;
+        }
+
+        TcbQueue * queue = write ? &rwlock->writers : &rwlock->readers;
+        me->thread_state = WAITING;
+        if (woken) {
+            me->next = queue->head;
+            queue->head = me;
+            if (me->next == NULL) {
+                queue->tail = me;
+            }
+        } else {
+            if (write) {
+                rwlock->writers_waiting++;
+            }
+            enqueueTcb(me, queue);
+        }
+        spinUnlock(&rwlock->guard);
+        scheduleNext(0);
+
+        woken = 1;
+        preemptDisable();
+        spinLock(&rwlock->guard);
+    }
+}
+
+/* acquire the lock shared */
+int my_pthread_rwlock_rdlock(my_pthread_rwlock_t *rwlock) {
+    unsigned int state = rwlock->state;
+    if (!(state & (RW_WRITER | RW_WAITERS)) &&
+        __sync_bool_compare_and_swap(&rwlock->state, state, state + 1)) {
+        return 0;
+    }
+    return rwlockContended(rwlock, 0, 1);
+}
+
+/* acquire the lock exclusive */
+int my_pthread_rwlock_wrlock(my_pthread_rwlock_t *rwlock) {
+    if (__sync_bool_compare_and_swap(&rwlock->state, 0, RW_WRITER)) {
+        rwlock->writer = self()->tid;
+        return 0;
+    }
+    return rwlockContended(rwlock, 1, 1);
+}
+
+/* acquire the lock shared without waiting */
+int my_pthread_rwlock_tryrdlock(my_pthread_rwlock_t *rwlock) {
+    unsigned int state = rwlock->state;
+    if (!(state & (RW_WRITER | RW_WAITERS)) &&
+        __sync_bool_compare_and_swap(&rwlock->state, state, state + 1)) {
+        return 0;
+    }
+    return rwlockContended(rwlock, 0, 0);
+}
+
+/* acquire the lock exclusive without waiting */
+int my_pthread_rwlock_trywrlock(my_pthread_rwlock_t *rwlock) {
+    if (__sync_bool_compare_and_swap(&rwlock->state, 0, RW_WRITER)) {
+        rwlock->writer = self()->tid;
+        return 0;
+    }
+    return rwlockContended(rwlock, 1, 0);
+}
+
+/* 
+ * drops a hold while someone is parked. The last one out wakes the first
+ * parked writer or every parked reader at once, whichever the preference
+ * picks.
+ */
+static int rwlockRelease(my_pthread_rwlock_t *rwlock) {
+    preemptDisable();
+    spinLock(&rwlock->guard);
+    unsigned int state, next;
+    do {
+        state = rwlock->state;
+        next = state & RW_WRITER ? state & ~RW_WRITER : state - 1;
+    } while (!__sync_bool_compare_and_swap(&rwlock->state, state, next));
+    tcb * woken = NULL;
+    if ((next & (RW_WRITER | RW_READERS)) == 0) {
+        if (rwlock->writers.head != NULL && (rwlock->prefer_writer || rwlock->readers.head == NULL)) {
+            woken = dequeueTcb(&rwlock->writers);
+            woken->next = NULL;
+        } else if (rwlock->readers.head != NULL) {
+            woken = rwlock->readers.head;
+            rwlock->readers.head = NULL;
+            rwlock->readers.tail = NULL;
+        }
+        if (rwlock->writers_waiting == 0 && rwlock->readers.head == NULL && rwlock->writers.head == NULL) {
+            __sync_fetch_and_and(&rwlock->state, ~RW_WAITERS);
+        }
+    }
+    spinUnlock(&rwlock->guard);
+    if (woken != NULL) {
+        readyWaiters(woken);
+    }
+    preemptEnable();
+    return 0;
+}
+
+/* release the reader-writer lock */
+int my_pthread_rwlock_unlock(my_pthread_rwlock_t *rwlock) {
+    unsigned int state = rwlock->state;
+    if (state & RW_WRITER) {
+        if (rwlock->writer != self()->tid) {
+            return -1;
+        }
+        rwlock->writer = -1;
+        if (__sync_bool_compare_and_swap(&rwlock->state, RW_WRITER, 0)) {
+            return 0;
+        }
+    } else {
+        if ((state & RW_READERS) == 0) {
+            return -1;
+        }
+        while (!(state & RW_WAITERS)) {
+            if (__sync_bool_compare_and_swap(&rwlock->state, state, state - 1)) {
+                return 0;
+            }
+            state = rwlock->state;
+        }
+    }
+    return rwlockRelease(rwlock);
+}
+
+/* destroy the reader-writer lock */
+int my_pthread_rwlock_destroy(my_pthread_rwlock_t *rwlock) {
+    if (rwlock->initialized != 1 || rwlock->state != 0) {
+        return -1;
+    }
+    rwlock->initialized = 0;
+    return 0;
+}
+
+/* initialize rwlock attributes to the defaults */
+int my_pthread_rwlockattr_init(my_pthread_rwlockattr_t *attr) {
+    attr->prefer_writer = 1;
+    return 0;
+}
+
+/* destroy rwlock attributes */
+int my_pthread_rwlockattr_destroy(my_pthread_rwlockattr_t *attr) {
+    return 0;
+}
+
+/* set whether parked writers go before readers */
+int my_pthread_rwlockattr_setpreferwriter(my_pthread_rwlockattr_t *attr, int prefer_writer) {
+    attr->prefer_writer = prefer_writer != 0;
+    return 0;
+}
+
+/* get the writer preference */
+int my_pthread_rwlockattr_getpreferwriter(const my_pthread_rwlockattr_t *attr, int *prefer_writer) {
+    *prefer_writer = attr->prefer_writer;
+    return 0;
+}
+
+/* initialize the semaphore */
+int my_pthread_sem_init(my_pthread_sem_t *sem, unsigned int value) {
+    if (sem->initialized == 1) {
+        return -1;
+    }
+    sem->value = value;
+    sem->initialized = 1;
+    sem->guard = 0;
+    sem->waiters.head = NULL;
+    sem->waiters.tail = NULL;
+    return 0;
+}
+
+/* 
+ * the wait path once the semaphore is empty: parks unless park is 0. A
+ * waiter queues itself before it looks at the value one last time and a
+ * post raises the value before it looks for waiters, so one of them
+ * always sees the other. Woken waiters take a unit like anyone else and
+ * go back on the front if they lose.
+ */
+static int semContended(my_pthread_sem_t *sem, int park) {
+    preemptDisable();
+    tcb * me = myWorker->current;
+    int woken = 0;
+    spinLock(&sem->guard);
+    for (;;) {
+        int value = sem->value;
+        if (value > 0) {
+            if (!__sync_bool_compare_and_swap(&sem->value, value, value - 1)) {
+                continue;
+            }
+            spinUnlock(&sem->guard);
+            preemptEnable();
+            return 0;
+        }
+        if (!park) {
+            spinUnlock(&sem->guard);
+            preemptEnable();
+            return EAGAIN;
+        }
+
+        me->thread_state = WAITING;
+        if (woken) {
+            me->next = sem->waiters.head;
+            sem->waiters.head = me;
+            if (me->next == NULL) {
+                sem->waiters.tail = me;
+            }
+        } else {
+            enqueueTcb(me, &sem->waiters);
+        }
+        __sync_synchronize();
+        if (sem->value > 0) {
+            removeFromTcbQueue(me, &sem->waiters);
+            me->thread_state = READY;
+            continue;
+        }
+        spinUnlock(&sem->guard);
+        scheduleNext(0);
+
+        woken = 1;
+        preemptDisable();
+        spinLock(&sem->guard);
+    }
+}
+
+/* take a unit of the semaphore */
+int my_pthread_sem_wait(my_pthread_sem_t *sem) {
+    int value = sem->value;
+    while (value > 0) {
+        if (__sync_bool_compare_and_swap(&sem->value, value, value - 1)) {
+            return 0;
+        }
+        value = sem->value;
+    }
+    return semContended(sem, 1);
+}
+
+/* take a unit of the semaphore without waiting */
+int my_pthread_sem_trywait(my_pthread_sem_t *sem) {
+    int value = sem->value;
+    while (value > 0) {
+        if (__sync_bool_compare_and_swap(&sem->value, value, value - 1)) {
+            return 0;
+        }
+        value = sem->value;
+    }
+    return semContended(sem, 0);
+}
+
+/* give back n units of the semaphore */
+int my_pthread_sem_postn(my_pthread_sem_t *sem, unsigned int n) {
+    if (sem->initialized != 1) {
+        return -1;
+    }
+    __sync_add_and_fetch(&sem->value, n);
+    if (sem->waiters.head == NULL) {
+        return 0;
+    }
+
+    // wake as many as there are new units, they all go on the ready queue together
+    TcbQueue woken = {NULL, NULL};
+    preemptDisable();
+    spinLock(&sem->guard);
+    while (n-- > 0 && sem->waiters.head != NULL) {
+        enqueueTcb(dequeueTcb(&sem->waiters), &woken);
+    }
+    spinUnlock(&sem->guard);
+    if (woken.head != NULL) {
+        readyWaiters(woken.head);
+    }
+    preemptEnable();
+    return 0;
+}
+
+/* give back a unit of the semaphore */
+int my_pthread_sem_post(my_pthread_sem_t *sem) {
+    return my_pthread_sem_postn(sem, 1);
+}
+
+/* read the semaphore's value */
+int my_pthread_sem_getvalue(my_pthread_sem_t *sem, int *value) {
+    *value = sem->value;
+    return 0;
+}
+
+/* destroy the semaphore */
+int my_pthread_sem_destroy(my_pthread_sem_t *sem) {
+    if (sem->initialized != 1 || sem->waiters.head != NULL) {
+        return -1;
+    }
+    sem->initialized = 0;
+    return 0;
+}
+
+/* initialize the barrier */
+int my_pthread_barrier_init(my_pthread_barrier_t *barrier, const my_pthread_barrierattr_t *barrierattr,
+                            unsigned int count) {
+    if (barrier->initialized == 1 || count == 0) {
+        return -1;
+    }
+    barrier->count = count;
+    barrier->arrived = 0;
+    barrier->initialized = 1;
+    barrier->guard = 0;
+    barrier->waiters.head = NULL;
+    barrier->waiters.tail = NULL;
+    return 0;
+}
+
+/* 
+ * parks every arrival but the last, which starts the next round and puts
+ * the whole batch on its ready queue at once. Only the last arrival wakes
+ * anyone, so a woken thread never has to check whether its round is over.
+ */
+int my_pthread_barrier_wait(my_pthread_barrier_t *barrier) {
+    tcb * me = self();
+    preemptDisable();
+    spinLock(&barrier->guard);
+    if (++barrier->arrived < barrier->count) {
+        me->thread_state = WAITING;
+        enqueueTcb(me, &barrier->waiters);
+        spinUnlock(&barrier->guard);
+        scheduleNext(0);
+        return 0;
+    }
+
+    tcb * woken = barrier->waiters.head;
+    barrier->arrived = 0;
+    barrier->waiters.head = NULL;
+    barrier->waiters.tail = NULL;
+    spinUnlock(&barrier->guard);
+    if (woken != NULL) {
+        readyWaiters(woken);
+    }
+    preemptEnable();
+    return MY_PTHREAD_BARRIER_SERIAL_THREAD;
+}
+
+/* destroy the barrier */
+int my_pthread_barrier_destroy(my_pthread_barrier_t *barrier) {
+    if (barrier->initialized != 1 || barrier->arrived != 0) {
+        return -1;
+    }
+    barrier->initialized = 0;
+    return 0;
+}
+
+/* initialize barrier attributes */
+int my_pthread_barrierattr_init(my_pthread_barrierattr_t *attr) {
+    return 0;
+}
+
+/* destroy barrier attributes */
+int my_pthread_barrierattr_destroy(my_pthread_barrierattr_t *attr) {
+    return 0;
+}
+
+/* initialize a channel buffering up to capacity messages, MY_CHAN_UNBOUNDED grows the buffer as needed */
+int my_chan_init(my_chan_t *chan, unsigned int capacity) {
+    if (chan->initialized == 1) {
+        return -1;
+    }
+    self();
+    chan->buf = NULL;
+    if (capacity != MY_CHAN_UNBOUNDED) {
+        preemptDisable();
+        chan->buf = malloc(capacity * sizeof(void *));
+        preemptEnable();
+        if (chan->buf == NULL) {
+            return -1;
+        }
+    }
+    chan->guard = 0;
+    chan->capacity = capacity;
+    chan->closed = 0;
+    chan->size = capacity;
+    chan->head = 0;
+    chan->count = 0;
+    chan->senders.head = NULL;
+    chan->senders.tail = NULL;
+    chan->receivers.head = NULL;
+    chan->receivers.tail = NULL;
+    chan->initialized = 1;
+    return 0;
+}
+
+static void chanPush(ChanQueue * queue, ChanWaiter * waiter) {
+    waiter->next = NULL;
+    waiter->prev = queue->tail;
+    if (queue->tail != NULL) {
+        queue->tail->next = waiter;
+    } else {
+        queue->head = waiter;
+    }
+    queue->tail = waiter;
+    waiter->queued = 1;
+}
+
+static void chanUnlink(ChanQueue * queue, ChanWaiter * waiter) {
+    if (waiter->prev != NULL) {
+        waiter->prev->next = waiter->next;
+    } else {
+        queue->head = waiter->next;
+    }
+    if (waiter->next != NULL) {
+        waiter->next->prev = waiter->prev;
+    } else {
+        queue->tail = waiter->prev;
+    }
+    waiter->queued = 0;
+}
+
+/* 
+ * takes the longest parked waiter that can still be completed. A select
+ * case whose select already fired on another channel is dropped on the way.
+ */
+static ChanWaiter * chanPop(ChanQueue * queue) {
+    ChanWaiter * waiter;
+    while ((waiter = queue->head) != NULL) {
+        chanUnlink(queue, waiter);
+        if (waiter->fired == NULL || __sync_bool_compare_and_swap(waiter->fired, 0, waiter->index + 1)) {
+            return waiter;
+        }
+    }
+    return NULL;
+}
+
+/* appends msg to the buffer, an unbounded one doubles when it is full */
+static int chanPut(my_chan_t * chan, void * msg) {
+    if (chan->count == chan->size) {
+        unsigned int size = chan->size > 0 ? chan->size * 2 : 16;
+        void ** buf = malloc(size * sizeof(void *));
+        if (buf == NULL) {
+            return -1;
+        }
+        unsigned int i;
+        for (i = 0; i < chan->count; i++) {
+            buf[i] = chan->buf[(chan->head + i) % chan->size];
+        }
+        free(chan->buf);
+        chan->buf = buf;
+        chan->size = size;
+        chan->head = 0;
+    }
+    chan->buf[(chan->head + chan->count) % chan->size] = msg;
+    chan->count++;
+    return 0;
+}
+
+static void * chanTake(my_chan_t * chan) {
+    void * msg = chan->buf[chan->head];
+    chan->head = (chan->head + 1) % chan->size;
+    chan->count--;
+    return msg;
+}
+
+/* 
+ * completes case c if it can go through without parking, with its channel's
+ * guard held. A parked receiver gets a message handed to it directly, a
+ * parked sender's message moves into the room a receive made; either way
+ * woken is the waiter to ready once the guard is dropped.
+ */
+static int chanTry(my_chan_case_t * c, ChanWaiter ** woken) {
+    my_chan_t * chan = c->chan;
+    ChanWaiter * waiter;
+    *woken = NULL;
+    if (c->op == MY_CHAN_SEND) {
+        if (chan->closed) {
+            c->ok = 0;
+            return 1;
+        }
+        if ((waiter = chanPop(&chan->receivers)) != NULL) {
+            waiter->msg = c->msg;
+            waiter->ok = 1;
+            *woken = waiter;
+            c->ok = 1;
+            return 1;
+        }
+        if (chan->capacity == MY_CHAN_UNBOUNDED || chan->count < chan->capacity) {
+            c->ok = chanPut(chan, c->msg) == 0;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (chan->count > 0) {
+        c->msg = chanTake(chan);
+        c->ok = 1;
+        if ((waiter = chanPop(&chan->senders)) != NULL) {
+            chanPut(chan, waiter->msg);
+            waiter->ok = 1;
+            *woken = waiter;
+        }
+        return 1;
+    }
+    if (chan->closed) {
+        c->msg = NULL;
+        c->ok = 0;
+        return 1;
+    }
+    return 0;
+}
+
+/* takes or drops the guards of every case's channel in address order, each channel once */
+static void lockChans(my_chan_case_t * cases, int * order, int n, int unlock) {
+    int i;
+    for (i = 0; i < n; i++) {
+        my_chan_t * chan = cases[order[i]].chan;
+        if (i > 0 && chan == cases[order[i - 1]].chan) {
+            continue;
+        }
+        if (unlock) {
+            spinUnlock(&chan->guard);
+        } else {
+            spinLock(&chan->guard);
+        }
+    }
+}
+
+/* 
+ * completes the first case that can go through, starting the search at a
+ * different case each call so one busy channel can't starve the others.
+ * Otherwise parks with a waiter queued on every channel until some other
+ * thread completes one of them.
+ */
+int my_chan_select(my_chan_case_t *cases, int n, int block) {
+    static unsigned int selectSeq = 0;
+    tcb * me = self();
+    int i, j;
+    if (n < 1) {
+        return -1;
+    }
+    // two selects over the same channels must lock them in the same order
+    int order[n];
+    for (i = 0; i < n; i++) {
+        for (j = i; j > 0 && cases[order[j - 1]].chan > cases[i].chan; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    preemptDisable();
+    lockChans(cases, order, n, 0);
+    int start = n > 1 ? selectSeq++ % n : 0;
+    for (j = 0; j < n; j++) {
+        ChanWaiter * woken;
+        i = (start + j) % n;
+        if (chanTry(&cases[i], &woken)) {
+            lockChans(cases, order, n, 1);
+            if (woken != NULL) {
+                // the waiter lives on its thread's stack, done with it once that runs
+                tcb * t = woken->thread;
+                t->next = NULL;
+                readyWaiters(t);
+            }
+            preemptEnable();
+            return i;
+        }
+    }
+    if (!block) {
+        lockChans(cases, order, n, 1);
+        preemptEnable();
+        return -1;
+    }
+
+    ChanWaiter waiters[n];
+    volatile int fired = 0;
+    for (i = 0; i < n; i++) {
+        waiters[i].thread = me;
+        waiters[i].msg = cases[i].msg;
+        waiters[i].ok = 0;
+        waiters[i].fired = n > 1 ? &fired : NULL;
+        waiters[i].index = i;
+        chanPush(cases[i].op == MY_CHAN_SEND ? &cases[i].chan->senders : &cases[i].chan->receivers,
+                 &waiters[i]);
+    }
+    me->thread_state = WAITING;
+    lockChans(cases, order, n, 1);
+    scheduleNext(0);
+
+    // whoever readied us completed one case, the others are still queued
+    int done = n > 1 ? fired - 1 : 0;
+    if (n > 1) {
+        preemptDisable();
+        lockChans(cases, order, n, 0);
+        for (i = 0; i < n; i++) {
+            if (waiters[i].queued) {
+                chanUnlink(cases[i].op == MY_CHAN_SEND ? &cases[i].chan->senders : &cases[i].chan->receivers,
+                           &waiters[i]);
+            }
+        }
+        lockChans(cases, order, n, 1);
+        preemptEnable();
+    }
+    if (cases[done].op == MY_CHAN_RECV) {
+        cases[done].msg = waiters[done].msg;
+    }
+    cases[done].ok = waiters[done].ok;
+    return done;
+}
+
+/* pass msg on, parking while a bounded buffer is full */
+int my_chan_send(my_chan_t *chan, void *msg) {
+    my_chan_case_t c = {chan, MY_CHAN_SEND, msg, 0};
+    my_chan_select(&c, 1, 1);
+    return c.ok ? 0 : -1;
+}
+
+/* take the next message, parking while there is none */
+int my_chan_recv(my_chan_t *chan, void **msg) {
+    my_chan_case_t c = {chan, MY_CHAN_RECV, NULL, 0};
+    my_chan_select(&c, 1, 1);
+    if (msg != NULL) {
+        *msg = c.msg;
+    }
+    return c.ok ? 0 : -1;
+}
+
+/* 
+ * no more sends. Every parked receiver and sender is readied in one batch
+ * with nothing, what is buffered can still be received.
+ */
+int my_chan_close(my_chan_t *chan) {
+    self();
+    preemptDisable();
+    spinLock(&chan->guard);
+    if (chan->closed) {
+        spinUnlock(&chan->guard);
+        preemptEnable();
+        return -1;
+    }
+    chan->closed = 1;
+    tcb * woken = NULL;
+    ChanWaiter * waiter;
+    while ((waiter = chanPop(&chan->receivers)) != NULL || (waiter = chanPop(&chan->senders)) != NULL) {
+        tcb * t = waiter->thread;
+        waiter->msg = NULL;
+        waiter->ok = 0;
+        t->next = woken;
+        woken = t;
+    }
+    spinUnlock(&chan->guard);
+    if (woken != NULL) {
+        readyWaiters(woken);
+    }
+    preemptEnable();
+    return 0;
+}
+
+/* destroy a channel nobody waits on, buffered messages are dropped */
+int my_chan_destroy(my_chan_t *chan) {
+    if (chan->initialized != 1 || chan->senders.head != NULL || chan->receivers.head != NULL) {
+        return -1;
+    }
+    chan->initialized = 0;
+    preemptDisable();
+    free(chan->buf);
+    preemptEnable();
+    chan->buf = NULL;
+    return 0;
+}
+
+/* 
+ * Starts one pool thread per worker on the first spawn. Whoever loses the
+ * race to start it waits for the deques to be set up, tasks it pushes
+ * before the pool threads exist sit on the inject list until they do.
+ */
+static void startPool() {
+    if (__atomic_load_n(&poolState, __ATOMIC_ACQUIRE) == 2) {
+        return;
+    }
+    self();
+    if (!__sync_bool_compare_and_swap(&poolState, 0, 1)) {
+        while (__atomic_load_n(&poolState, __ATOMIC_ACQUIRE) != 2) {
+            my_pthread_yield();
+        }
+        return;
+    }
+    int i;
+    taskPool.size = numWorkers;
+    preemptDisable();
+    for (i = 0; i < taskPool.size; i++) {
+        initDeque(&taskPool.deques[i]);
+    }
+    preemptEnable();
+    my_pthread_sem_init(&taskPool.wake, 0);
+    __atomic_store_n(&poolState, 2, __ATOMIC_RELEASE);
+
+    my_pthread_t pool[MAX_WORKERS];
+    void * ids[MAX_WORKERS];
+    for (i = 0; i < taskPool.size; i++) {
+        ids[i] = (void *) (long) i;
+    }
+    my_pthread_create_n(pool, taskPool.size, NULL, &taskLoop, ids);
+}
+
+/* 
+ * A pool thread runs tasks for good. With nothing to run it counts itself
+ * idle and looks once more, so a spawn either sees it idle and posts wake
+ * or pushed before the second look and gets found.
+ */
+static void * taskLoop(void * arg) {
+    tcb * me = self();
+    me->task_deque = &taskPool.deques[(long) arg];
+    while (1) {
+        Task * task = findTask(me);
+        if (task == NULL) {
+            __sync_add_and_fetch(&taskPool.idle, 1);
+            task = findTask(me);
+            if (task != NULL) {
+                // take the idle count back, unless a spawner already claimed it to post wake
+                int idle = taskPool.idle;
+                while (idle > 0 && !__sync_bool_compare_and_swap(&taskPool.idle, idle, idle - 1)) {
+                    idle = taskPool.idle;
+                }
+                if (idle == 0) {
+                    my_pthread_sem_wait(&taskPool.wake);
+                }
+            } else {
+                my_pthread_sem_wait(&taskPool.wake);
+            }
+        }
+        if (task != NULL) {
+            runTask(me, task);
+        }
+    }
+    return NULL;
+}
+
+/* 
+ * next task for me: the newest on its own deque, the oldest on another
+ * pool thread's, then the oldest spawned from outside the pool
+ */
+static Task * findTask(tcb * me) {
+    Task * task = NULL;
+    int i, first = 0;
+    if (me->task_deque != NULL) {
+        preemptDisable();
+        task = dequePop(me->task_deque);
+        preemptEnable();
+        if (task != NULL) {
+            return task;
+        }
+        first = me->task_deque - taskPool.deques + 1;
     }
-    else {
-        currentThread = to_run; 
-        setcontext(to_run->thread_context); 
+    for (i = 0; i < taskPool.size; i++) {
+        WsDeque * victim = &taskPool.deques[(first + i) % taskPool.size];
+        if (victim != me->task_deque && (task = dequeSteal(victim)) != NULL) {
+            return task;
+        }
+    }
+    if (taskPool.inject_head != NULL) {
+        preemptDisable();
+        spinLock(&taskPool.lock);
+        task = taskPool.inject_head;
+        if (task != NULL) {
+            taskPool.inject_head = task->next;
+            if (task->next == NULL) {
+                taskPool.inject_tail = NULL;
+            }
+        }
+        spinUnlock(&taskPool.lock);
+        preemptEnable();
     }
+    return task;
 }
 
-/* create a new thread */
-int my_pthread_create(my_pthread_t *thread, pthread_attr_t *attr,
-                      void *(*function)(void *), void *arg) {
-	if (firstTimeRunning == 0) {
-		init();
-	}
-	
-	// Make the context for this new thread
-    ucontext_t * newThread = (ucontext_t*)malloc(sizeof(ucontext_t));
-    getcontext(newThread);  
-    newThread->uc_stack.ss_sp = malloc(STACK_SIZE);
-    newThread->uc_stack.ss_size = STACK_SIZE; 
-    newThread->uc_stack.ss_flags = 0;  
-    newThread->uc_link = &exitContext; 
-    makecontext(newThread, (void*)function, 1, arg); 
-
-    // Create a thread control block for this new thread
-    *thread = ++tids; 
-    tcb * newBlock = malloc(sizeof(tcb)); 
-    newBlock->thread_context = newThread; 
-    newBlock->run_time = 0; 
-    newBlock->priority = 0;
-    newBlock->join_id = 0; 
-    newBlock->thread_state = READY;
-    newBlock->tid = *thread;  
-
-    // Add the new block to the scheduling queue
-    enqueueTcb(newBlock, schedQueue); 
-
-    // Call my pthread_yield to begin scheduling
-    my_pthread_yield(); 
-    
-    return 0;
-};
+/* runs a task in a frame of its own and syncs its children before its parent hears it is done */
+static void runTask(tcb * me, Task * task) {
+    TaskFrame frame = {0, NULL};
+    TaskFrame * saved = me->task_frame;
+    me->task_frame = &frame;
+    if (task->body != NULL) {
+        splitRange(me, task->body, task->start, task->end, task->grain, task->arg);
+    } else {
+        task->function(task->arg);
+    }
+    my_task_sync();
+    me->task_frame = saved;
 
-/* give CPU pocession to other user level threads voluntarily */
-int my_pthread_yield() {
-    getitimer(ITIMER_REAL, &timer);
-    timer.it_value.tv_usec = 0;
-    setitimer(ITIMER_REAL, &timer, NULL);
-    schedule();
-    return 0;
-};
+    TaskFrame * parent = task->parent;
+    preemptDisable();
+    free(task);
+    preemptEnable();
+    finishTask(parent);
+}
 
-/* terminate a thread */
-void my_pthread_exit(void *value_ptr) {
-	// Find any thread that was waiting for this thread to exit
-	tcb * ptr = waitQueue->head; 
-    while (ptr != NULL) {
-        if (ptr->join_id == currentThread->tid )
-            break; 
-        ptr = ptr->next; 
-    }
-
-    // Put this thread onto the scheduling queue
-    if (ptr != NULL) {
-		ptr->thread_state = READY; 
-		#ifndef MLFQ
-			//SJF
-			enqueueTcb(ptr, schedQueue);
-		#else
-			//MLFQ
-			if(ptr->priority == 0){
-				enqueueTcb(ptr, schedQueue);
-			}else if(ptr->priority == 1){
-				enqueueTcb(ptr, queue2);
-			}else if(ptr->priority == 2){
-				enqueueTcb(ptr, queue3);
-			}else{
-				enqueueTcb(ptr, queue4);
-			}
-		#endif		
+/* 
+ * counts a child of parent done. A parked parent stays parked until the
+ * last child readies it, so its frame is still there to read the waiter from.
+ */
+static void finishTask(TaskFrame * parent) {
+    if (__sync_fetch_and_sub(&parent->pending, 1) == (TASK_WAITING | 1)) {
+        tcb * waiter = parent->waiter;
+        waiter->next = NULL;
+        preemptDisable();
+        readyWaiters(waiter);
+        preemptEnable();
     }
-    
-    // Insert return value into the list of return values
-    if (value_ptr != NULL) {
-        ret *new_Val = (ret*)malloc(sizeof(ret)); 
-        new_Val->returnVal = value_ptr; 
-        new_Val->tid = currentThread->tid; 
-        enqueueRet(new_Val, retQueue);
-    }
-        
-    free(currentThread->thread_context->uc_stack.ss_sp);
-    free(currentThread->thread_context); 
-    free(currentThread);
-    currentThread = NULL;   
-    my_pthread_yield(); 
-};
+}
 
-/* wait for thread termination */
-int my_pthread_join(my_pthread_t thread, void **value_ptr) {
-    tcb * potential_thread_ready = findTCB(thread, schedQueue);
-	#ifdef MLFQ
-		//mlfq, if potential is NULL, check other queues
-		if(potential_thread_ready == NULL){
-			potential_thread_ready = findTCB(thread, queue2);
-			if(potential_thread_ready == NULL){
-				potential_thread_ready = findTCB(thread, queue3);
-				if(potential_thread_ready == NULL){
-					potential_thread_ready = findTCB(thread, queue4);
-				}
-			}
-		}
-	#endif
-    if (potential_thread_ready != NULL ) {
-        currentThread->thread_state = WAITING; 
-        currentThread->join_id = thread; 
-        enqueueTcb(currentThread, waitQueue);
-        my_pthread_yield(); 
+/* counts task against the caller's frame and queues it where the pool finds it */
+static void spawnTask(tcb * me, Task * task) {
+    task->parent = me->task_frame != NULL ? me->task_frame : &me->task_root;
+    __sync_add_and_fetch(&task->parent->pending, 1);
+    preemptDisable();
+    if (me->task_deque != NULL) {
+        dequePush(me->task_deque, task);
+    } else {
+        task->next = NULL;
+        spinLock(&taskPool.lock);
+        if (taskPool.inject_tail != NULL) {
+            taskPool.inject_tail->next = task;
+        } else {
+            taskPool.inject_head = task;
+        }
+        taskPool.inject_tail = task;
+        spinUnlock(&taskPool.lock);
     }
-    
-    ret * retVal = findRet(thread, retQueue);
-    
-    if (retVal != NULL) {
-		*value_ptr = retVal->returnVal;
-		removeFromRetQueue(retVal, retQueue);
-	}
-	
-    return 0;
-}
+    preemptEnable();
 
-tcb * findTCB(my_pthread_t tid, TcbQueue * queue) {
-    tcb *temp = queue->head;
-    while (temp != NULL) {
-        if (temp->tid == tid) {
-            return temp;
+    // pairs with the idle count going up before a pool thread's last look
+    __sync_synchronize();
+    int idle = taskPool.idle;
+    while (idle > 0) {
+        if (__sync_bool_compare_and_swap(&taskPool.idle, idle, idle - 1)) {
+            my_pthread_sem_post(&taskPool.wake);
+            break;
         }
-        temp = temp->next;
+        idle = taskPool.idle;
     }
-    return NULL;
 }
 
-ret * findRet(my_pthread_t tid, RetQueue * queue) {
-    ret *temp = queue->head;
-    while (temp != NULL) {
-        if (temp->tid == tid) {
-            return temp;
+/* 
+ * halves [start, end) until it is no bigger than grain, spawning each upper
+ * half so thieves take the big pieces, and runs what is left here
+ */
+static void splitRange(tcb * me, void (*body)(long, long, void *), long start, long end, long grain, void * arg) {
+    while (end - start > grain) {
+        long mid = start + (end - start) / 2;
+        preemptDisable();
+        Task * task = malloc(sizeof(Task));
+        preemptEnable();
+        if (task == NULL) {
+            break;
         }
-        temp = temp->next;
+        task->function = NULL;
+        task->body = body;
+        task->arg = arg;
+        task->start = mid;
+        task->end = end;
+        task->grain = grain;
+        spawnTask(me, task);
+        end = mid;
     }
-    return NULL;
+    body(start, end, arg);
 }
 
-/* initialize the mutex lock */
-int my_pthread_mutex_init(my_pthread_mutex_t *mutex,
-                          const pthread_mutexattr_t *mutexattr) {
-    if (mutex->initialized == 1) {
+/* run function(arg) on the task pool as a child of the calling task */
+int my_task_spawn(void (*function)(void *), void *arg) {
+    startPool();
+    preemptDisable();
+    Task * task = malloc(sizeof(Task));
+    preemptEnable();
+    if (task == NULL) {
         return -1;
     }
-    mutex->lock = 0;
-    mutex->initialized = 1;
-    mutex->tid = -1;
-    mutex->destroyed = 0;
+    task->function = function;
+    task->body = NULL;
+    task->arg = arg;
+    spawnTask(self(), task);
     return 0;
-};
+}
 
-/* aquire the mutex lock */
-int my_pthread_mutex_lock(my_pthread_mutex_t *mutex) {
-	if (mutex->destroyed == 1) {
-        return -1; 
+/* 
+ * waits for the caller's children. A pool thread runs what it can find in
+ * the meantime, its own children first. Any other thread parks right away,
+ * the tasks it would pick up spawn onto the inject list and running them
+ * here would only nest ever deeper on its stack.
+ */
+int my_task_sync() {
+    tcb * me = self();
+    TaskFrame * frame = me->task_frame != NULL ? me->task_frame : &me->task_root;
+    while (me->task_deque != NULL && frame->pending > 0) {
+        Task * task = findTask(me);
+        if (task == NULL) {
+            break;
+        }
+        runTask(me, task);
     }
 
-    while (__sync_lock_test_and_set(&mutex->lock, 1) == 1){
-        my_pthread_yield(); 
+    // stolen children are still running elsewhere, the last one to finish readies us
+    preemptDisable();
+    frame->waiter = me;
+    me->thread_state = WAITING;
+    long pending = frame->pending;
+    while (pending > 0 && !__sync_bool_compare_and_swap(&frame->pending, pending, pending | TASK_WAITING)) {
+        pending = frame->pending;
     }
-
-    mutex->tid = currentThread->tid; 
+    if (pending == 0) {
+        me->thread_state = READY;
+        preemptEnable();
+        return 0;
+    }
+    scheduleNext(0);
+    frame->pending = 0;
     return 0;
-};
+}
 
-/* release the mutex lock */
-int my_pthread_mutex_unlock(my_pthread_mutex_t *mutex) {	
-	if (mutex->destroyed == 1 || mutex->tid != currentThread->tid) {
-        return -1; 
+/* run body over [start, end) on the task pool in pieces of at most grain */
+int my_parallel_for(long start, long end, long grain, void (*body)(long, long, void *), void *arg) {
+    if (end <= start) {
+        return 0;
     }
-
-    mutex->tid = -1; 
-    __sync_lock_release(&mutex->lock); 
+    startPool();
+    if (grain <= 0) {
+        // eight pieces per pool thread leaves room to even out the load
+        grain = (end - start) / (8 * taskPool.size);
+        if (grain < 1) {
+            grain = 1;
+        }
+    }
+    // the pieces get a frame of their own so only they are waited for
+    tcb * me = self();
+    TaskFrame frame = {0, NULL};
+    TaskFrame * saved = me->task_frame;
+    me->task_frame = &frame;
+    splitRange(me, body, start, end, grain, arg);
+    my_task_sync();
+    me->task_frame = saved;
     return 0;
-};
+}
 
+/* orders two heap nodes by key, then by insertion. Passes may wrap, so keys compare by difference */
+static int shorterTcb(tcb * a, tcb * b) {
+    long long diff = (long long) (a->key - b->key);
+    return diff < 0 || (diff == 0 && a->seq < b->seq);
+}
 
-/* destroy the mutex */
-int my_pthread_mutex_destroy(my_pthread_mutex_t *mutex) {
-	if (mutex->lock == 1 || mutex->destroyed == 1) {
-        return -1; 
+/* links two heap roots, the longer one becomes the first child of the other */
+static tcb * meldTcb(tcb * a, tcb * b) {
+    if (shorterTcb(b, a)) {
+        tcb * temp = a;
+        a = b;
+        b = temp;
     }
-
-    mutex->destroyed = 1; 
-    mutex->tid = -1; 
-    mutex->initialized = 0;
-    return 0; 
-};
-
-tcb * getSJF(TcbQueue * queue){
-	//return lowest run time from queue
-	if(queue->head == NULL){
-		return NULL;
-	}
-	tcb * out = queue->head;
-	tcb * temp = out->next;
-	while(temp != NULL){
-		if(temp->run_time < out->run_time){
-			out = temp;
-		}
-		temp = temp->next;
-	}
-	return out;
+    b->sibling = a->child;
+    if (a->child != NULL) {
+        a->child->prev = b;
+    }
+    b->prev = a;
+    a->child = b;
+    a->prev = NULL;
+    return a;
 }
 
-/* removes a return value from a return value queue */
-void removeFromRetQueue(ret * toDequeue, RetQueue * queue) {
-    if (queue->head == NULL)
-        return;
+/* inserts a tcb into a heap in O(1) */
+int insertTcbHeap(tcb * toInsert, TcbHeap * heap) {
+    if (toInsert == NULL) {
+        return -1;
+    }
+    toInsert->seq = heap->seq++;
+    toInsert->child = NULL;
+    toInsert->sibling = NULL;
+    toInsert->prev = NULL;
+    heap->root = heap->root == NULL ? toInsert : meldTcb(heap->root, toInsert);
+    return 0;
+}
 
-    ret * temp = queue->head;
+/* melds a list of sibling subtrees into one, the two-pass pairing step */
+static tcb * mergePairs(tcb * first) {
+    // first pass melds the children in pairs left to right, building a reversed list
+    tcb * pairs = NULL;
+    while (first != NULL) {
+        tcb * a = first;
+        tcb * b = a->sibling;
+        if (b == NULL) {
+            a->sibling = pairs;
+            pairs = a;
+            break;
+        }
+        first = b->sibling;
+        a->sibling = NULL;
+        b->sibling = NULL;
+        a = meldTcb(a, b);
+        a->sibling = pairs;
+        pairs = a;
+    }
 
-    if (toDequeue == queue->head) {
-        queue->head = temp->next;
-        free(temp);
-        return;
+    // second pass melds the pairs back right to left into one root
+    tcb * root = NULL;
+    while (pairs != NULL) {
+        tcb * next = pairs->sibling;
+        pairs->sibling = NULL;
+        root = root == NULL ? pairs : meldTcb(root, pairs);
+        pairs = next;
     }
-    
-    while (temp != NULL && temp->next != toDequeue) {
-        temp = temp->next;
+    if (root != NULL) {
+        root->prev = NULL;
+    }
+    return root;
+}
+
+/* removes the tcb with the smallest key, O(log n) amortized */
+tcb * popTcbHeap(TcbHeap * heap) {
+    tcb * out = heap->root;
+    if (out == NULL) {
+        return NULL;
     }
+    heap->root = mergePairs(out->child);
+    out->child = NULL;
+    return out;
+}
 
-    if (temp == NULL || temp->next == NULL) {
+/* removes any tcb in the heap: cut its subtree loose and meld its children back in */
+void removeTcbHeap(tcb * toRemove, TcbHeap * heap) {
+    if (toRemove == heap->root) {
+        popTcbHeap(heap);
         return;
-	}
-      
-    ret *next = temp->next->next;
-    free(temp->next);
-    temp->next = next;
-    if(toDequeue == queue->tail){
-		queue->tail = temp;
-	}
+    }
+    tcb * prev = toRemove->prev;
+    if (prev->child == toRemove) {
+        prev->child = toRemove->sibling;
+    } else {
+        prev->sibling = toRemove->sibling;
+    }
+    if (toRemove->sibling != NULL) {
+        toRemove->sibling->prev = prev;
+    }
+    tcb * rest = mergePairs(toRemove->child);
+    toRemove->child = NULL;
+    toRemove->sibling = NULL;
+    toRemove->prev = NULL;
+    if (rest != NULL) {
+        heap->root = meldTcb(heap->root, rest);
+    }
 }
 
+/* 
+ * The queue operations leave lists half relinked midway, every caller runs
+ * them between preemptDisable and preemptEnable.
+ */
+
 /* removes a thread block from a thread block queue */
 void removeFromTcbQueue(tcb *toDequeue, TcbQueue * queue) {
     if (queue->head == NULL) {
@@ -476,34 +3152,72 @@ int enqueueTcb(tcb *toInsert, TcbQueue *queue) {
     }
 }
 
-/* dequeue's the head of a ret queue */
-ret * dequeueRet(RetQueue * queue) {
-    if (queue->head != NULL) {
-		ret * b = queue->head;
-		queue->head = queue->head->next;
-        return b;
-	} else {
-		return NULL;
-	}
+/* grows a full deque, only the owner calls this */
+static DequeArray * growDeque(WsDeque * deque, DequeArray * old, long top, long bottom) {
+    long size = (old->mask + 1) * 2;
+    DequeArray * a = malloc(sizeof(DequeArray) + size * sizeof(void *));
+    long i;
+    a->mask = size - 1;
+    for (i = top; i < bottom; i++) {
+        a->slot[i & a->mask] = old->slot[i & old->mask];
+    }
+    // a thief may still be reading the old ring, so it's kept around
+    a->retired = old;
+    __atomic_store_n(&deque->array, a, __ATOMIC_RELEASE);
+    return a;
 }
 
-/* enqueue's a ret queue */
-int enqueueRet(ret *toInsert, RetQueue *queue) {
-    // Case the queue is empty
-    if (queue->head == NULL) {
-    	if(toInsert == NULL) {
-    		return -1;
-    	}
-        queue->head = toInsert;
-        queue->tail = toInsert;
-        queue->tail->next = NULL;
+/* pushes onto the bottom of the owner's deque */
+void dequePush(WsDeque * deque, void * toPush) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    DequeArray * a = deque->array;
+    if (bottom - top > a->mask) {
+        a = growDeque(deque, a, top, bottom);
     }
-        // Add to the end of the queue
-    else {
-        queue->tail->next = toInsert;
-        queue->tail = toInsert;
-        queue->tail->next = NULL;
+    __atomic_store_n(&a->slot[bottom & a->mask], toPush, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+/* pops the most recently pushed entry, only the owner calls this */
+void * dequePop(WsDeque * deque) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    DequeArray * a = deque->array;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+    void * out = NULL;
+    if (top <= bottom) {
+        out = __atomic_load_n(&a->slot[bottom & a->mask], __ATOMIC_RELAXED);
+        if (top == bottom) {
+            // last one left, race the thieves for it
+            if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                out = NULL;
+            }
+            __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return out;
+}
+
+/* takes the oldest entry off someone else's deque, NULL if empty or we lost a race */
+void * dequeSteal(WsDeque * deque) {
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if (top < bottom) {
+        DequeArray * a = __atomic_load_n(&deque->array, __ATOMIC_ACQUIRE);
+        void * out = __atomic_load_n(&a->slot[top & a->mask], __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            return out;
+        }
     }
+    return NULL;
 }
 
 /* Helper function to print out a tcb queue */
@@ -516,3 +3230,369 @@ void printTcbQueue(TcbQueue * queue) {
     }
     printf("]\n");
 }
+
+/* set the number of kernel workers, must be called before the first create */
+int my_pthread_setconcurrency(int n) {
+    if (firstTimeRunning == 1 || n < 0 || n > MAX_WORKERS) {
+        return -1;
+    }
+    // 0 goes back to the default
+    numWorkers = n;
+    return 0;
+}
+
+/* number of kernel workers in use */
+int my_pthread_getconcurrency() {
+    return numWorkers;
+}
+
+/* initialize thread attributes to the defaults */
+int my_pthread_attr_init(my_pthread_attr_t *attr) {
+    attr->stacksize = STACK_SIZE;
+    attr->guardsize = sysconf(_SC_PAGESIZE);
+    attr->tickets = DEFAULT_TICKETS;
+    attr->yield = 1;
+    attr->detachstate = MY_PTHREAD_CREATE_JOINABLE;
+    return 0;
+}
+
+/* destroy thread attributes */
+int my_pthread_attr_destroy(my_pthread_attr_t *attr) {
+    return 0;
+}
+
+/* set the stack reservation of threads created with attr */
+int my_pthread_attr_setstacksize(my_pthread_attr_t *attr, size_t stacksize) {
+    if (stacksize < MIN_STACK_SIZE) {
+        return -1;
+    }
+    attr->stacksize = stacksize;
+    return 0;
+}
+
+/* get the stack reservation */
+int my_pthread_attr_getstacksize(const my_pthread_attr_t *attr, size_t *stacksize) {
+    *stacksize = attr->stacksize;
+    return 0;
+}
+
+/* set the guard size, 0 drops the guard page */
+int my_pthread_attr_setguardsize(my_pthread_attr_t *attr, size_t guardsize) {
+    attr->guardsize = guardsize;
+    return 0;
+}
+
+/* get the guard size */
+int my_pthread_attr_getguardsize(const my_pthread_attr_t *attr, size_t *guardsize) {
+    *guardsize = attr->guardsize;
+    return 0;
+}
+
+/* set the stride tickets of threads created with attr */
+int my_pthread_attr_settickets(my_pthread_attr_t *attr, unsigned int tickets) {
+    if (tickets < 1 || tickets > STRIDE1) {
+        return -1;
+    }
+    attr->tickets = tickets;
+    return 0;
+}
+
+/* get the stride tickets */
+int my_pthread_attr_gettickets(const my_pthread_attr_t *attr, unsigned int *tickets) {
+    *tickets = attr->tickets;
+    return 0;
+}
+
+/* whether creating with attr yields so the new threads get to run, 0 leaves them queued */
+int my_pthread_attr_setyield(my_pthread_attr_t *attr, int yield) {
+    attr->yield = yield != 0;
+    return 0;
+}
+
+/* get whether create yields */
+int my_pthread_attr_getyield(const my_pthread_attr_t *attr, int *yield) {
+    *yield = attr->yield;
+    return 0;
+}
+
+/* create threads joinable or detached */
+int my_pthread_attr_setdetachstate(my_pthread_attr_t *attr, int detachstate) {
+    if (detachstate != MY_PTHREAD_CREATE_JOINABLE && detachstate != MY_PTHREAD_CREATE_DETACHED) {
+        return -1;
+    }
+    attr->detachstate = detachstate;
+    return 0;
+}
+
+/* get the detach state */
+int my_pthread_attr_getdetachstate(const my_pthread_attr_t *attr, int *detachstate) {
+    *detachstate = attr->detachstate;
+    return 0;
+}
+
+/* cap the number of exited threads' stacks kept for reuse */
+int my_pthread_setstackpool(int cap) {
+    if (cap < 0) {
+        return -1;
+    }
+    self();
+    preemptDisable();
+    spinLock(&stackLock);
+    stackPoolCap = cap;
+    ThreadStack * extra = NULL;
+    while (stackStats.pooled > cap) {
+        ThreadStack * st = stackPool;
+        stackPool = st->next;
+        stackStats.pooled--;
+        st->next = extra;
+        extra = st;
+    }
+    spinUnlock(&stackLock);
+    while (extra != NULL) {
+        ThreadStack * next = extra->next;
+        unmapStack(extra);
+        extra = next;
+    }
+    preemptEnable();
+    return 0;
+}
+
+/* read the stack pool counters */
+int my_pthread_getstackstats(my_pthread_stackstats_t *stats) {
+    // a reader preempted holding the lock would leave creates and exits on its worker spinning
+    self();
+    preemptDisable();
+    spinLock(&stackLock);
+    *stats = stackStats;
+    spinUnlock(&stackLock);
+    preemptEnable();
+    return 0;
+}
+
+/* cpu time a thread has used in ns, exact for the caller, as of its last switch for others */
+int my_pthread_getcputime(my_pthread_t thread, unsigned long long *nsec) {
+    tcb * me = self();
+    if (thread > tids) {
+        return -1;
+    }
+    preemptDisable();
+    if (thread == me->tid) {
+        // the running slice hasn't been charged yet
+        *nsec = me->run_time + (nowNs() - myWorker->slice_start);
+        preemptEnable();
+        return 0;
+    }
+    ThreadSlot * slot = findSlot(thread);
+    spinLock(&slot->lock);
+    int live = slotLive(slot);
+    if (live) {
+        *nsec = slot->block != NULL ? slot->block->run_time : slot->run_time;
+    }
+    spinUnlock(&slot->lock);
+    preemptEnable();
+    return live ? 0 : -1;
+}
+
+/* initialize MLFQ tuning to the defaults */
+int my_pthread_mlfqattr_init(my_pthread_mlfqattr_t *attr) {
+    int q;
+    attr->levels = DEFAULT_MLFQ_LEVELS;
+    for (q = 0; q < MAX_MLFQ_LEVELS; q++) {
+        attr->quantum_usec[q] = RUN_TIME_USEC * (q + 1);
+        attr->allot_usec[q] = attr->quantum_usec[q] * DEFAULT_MLFQ_ALLOT;
+    }
+    attr->boost_usec = DEFAULT_MLFQ_BOOST_USEC;
+    return 0;
+}
+
+/* set the MLFQ levels, quanta, allotments and boost, must be called before the first create */
+int my_pthread_setmlfq(const my_pthread_mlfqattr_t *attr) {
+    int q;
+    if (firstTimeRunning == 1 || attr->levels < 1 || attr->levels > MAX_MLFQ_LEVELS) {
+        return -1;
+    }
+    for (q = 0; q < attr->levels; q++) {
+        if (attr->quantum_usec[q] == 0 || attr->allot_usec[q] == 0) {
+            return -1;
+        }
+    }
+    mlfq = *attr;
+    mlfqSet = 1;
+    return 0;
+}
+
+/* read the MLFQ tuning in use */
+int my_pthread_getmlfq(my_pthread_mlfqattr_t *attr) {
+    if (!mlfqSet && firstTimeRunning == 0) {
+        defaultMlfq();
+        mlfqSet = 1;
+    }
+    *attr = mlfq;
+    return 0;
+}
+
+/* change a thread's stride tickets, 1 to STRIDE1 */
+int my_pthread_settickets(my_pthread_t thread, unsigned int tickets) {
+    self();
+    if (thread > tids || tickets < 1 || tickets > STRIDE1) {
+        return -1;
+    }
+    // only the running thread's next charge reads tickets, the heap order stays valid
+    ThreadSlot * slot = findSlot(thread);
+    preemptDisable();
+    spinLock(&slot->lock);
+    tcb * block = slot->block;
+    if (block != NULL) {
+        block->tickets = tickets;
+    }
+    spinUnlock(&slot->lock);
+    preemptEnable();
+    return block != NULL ? 0 : -1;
+}
+
+/* read a thread's stride tickets */
+int my_pthread_gettickets(my_pthread_t thread, unsigned int *tickets) {
+    self();
+    if (thread > tids) {
+        return -1;
+    }
+    ThreadSlot * slot = findSlot(thread);
+    preemptDisable();
+    spinLock(&slot->lock);
+    tcb * block = slot->block;
+    if (block != NULL) {
+        *tickets = block->tickets;
+    }
+    spinUnlock(&slot->lock);
+    preemptEnable();
+    return block != NULL ? 0 : -1;
+}
+
+/* pick the scheduling policy by name ("stcf", "mlfq" or "stride"), must be called before the first create */
+int my_pthread_setpolicy(const char *name) {
+    SchedOps * ops = findPolicy(name);
+    if (firstTimeRunning == 1 || ops == NULL) {
+        return -1;
+    }
+    policy = ops;
+    policySet = 1;
+    return 0;
+}
+
+/* name of the scheduling policy in use */
+const char * my_pthread_getpolicy() {
+    return policy->name;
+}
+
+/* 
+ * put the caller in the EDF class: runtime usec of cpu every period usec,
+ * due deadline usec after each release. Fails if it would overcommit the
+ * workers, all zero leaves the class.
+ */
+int my_pthread_setdeadline(unsigned long runtime_usec, unsigned long deadline_usec,
+                           unsigned long period_usec) {
+    tcb * me = self();
+    ThreadSlot * slot = findSlot(me->tid);
+    EdfState * edf = slot->edf;
+    if (runtime_usec == 0 && deadline_usec == 0 && period_usec == 0) {
+        if (edf != NULL) {
+            leaveEdf(edf);
+            preemptDisable();
+            me->edf = NULL;
+            preemptEnable();
+        }
+        return 0;
+    }
+    if (runtime_usec == 0 || runtime_usec > deadline_usec || deadline_usec > period_usec) {
+        return -1;
+    }
+
+    // admission: the reserved share of all workers together stays under the cap
+    unsigned long util = runtime_usec * 1000000 / period_usec;
+    unsigned long old = edf != NULL && edf->admitted ? edf->runtime * 1000000 / edf->period : 0;
+    preemptDisable();
+    spinLock(&edfLock);
+    if (edfUtil - old + util > (unsigned long) numWorkers * EDF_MAX_UTIL_PERCENT * 10000) {
+        spinUnlock(&edfLock);
+        preemptEnable();
+        return -1;
+    }
+    edfUtil = edfUtil - old + util;
+    spinUnlock(&edfLock);
+
+    if (edf == NULL) {
+        edf = calloc(1, sizeof(EdfState));
+        spinLock(&slot->lock);
+        slot->edf = edf;
+        spinUnlock(&slot->lock);
+    }
+    edf->runtime = runtime_usec * 1000ULL;
+    edf->deadline = deadline_usec * 1000ULL;
+    edf->period = period_usec * 1000ULL;
+    edf->admitted = 1;
+    // the first job starts now
+    unsigned long long now = nowNs();
+    edf->release = now;
+    edf->abs_deadline = edf->release + edf->deadline;
+    edf->job_base = me->run_time + (now - myWorker->slice_start);
+    me->edf = edf;
+    preemptEnable();
+    return 0;
+}
+
+/* an EDF thread ends its current job, sleeping until the next release if it is early */
+int my_pthread_waitperiod() {
+    tcb * me = self();
+    EdfState * edf = me->edf;
+    if (edf == NULL) {
+        return -1;
+    }
+    unsigned long long now = nowNs();
+    long long lateness = (long long) (now - (edf->release + edf->deadline));
+    // getdeadlinestats copies the counters under the slot lock
+    ThreadSlot * slot = findSlot(me->tid);
+    preemptDisable();
+    spinLock(&slot->lock);
+    edf->stats.jobs++;
+    if (lateness > 0) {
+        edf->stats.misses++;
+    }
+    if (edf->stats.jobs == 1 || lateness > edf->stats.worst_lateness_ns) {
+        edf->stats.worst_lateness_ns = lateness;
+    }
+    if (now - edf->release > edf->stats.worst_response_ns) {
+        edf->stats.worst_response_ns = now - edf->release;
+    }
+    spinUnlock(&slot->lock);
+
+    // the next job's release; one that is already due starts right away
+    edf->release += edf->period;
+    edf->abs_deadline = edf->release + edf->deadline;
+    edf->job_base = me->run_time + (nowNs() - myWorker->slice_start);
+    if ((long long) (edf->release - now) > 0) {
+        preemptEnable();
+        sleepUntil(edf->release);
+    } else {
+        preemptEnable();
+    }
+    return 0;
+}
+
+/* read an EDF thread's deadline-miss counters */
+int my_pthread_getdeadlinestats(my_pthread_t thread, my_pthread_edfstats_t *stats) {
+    self();
+    if (thread > tids) {
+        return -1;
+    }
+    // join or detach frees edf with the slot, and the tid may name a new thread by now
+    ThreadSlot * slot = findSlot(thread);
+    preemptDisable();
+    spinLock(&slot->lock);
+    int found = slotLive(slot) && slot->edf != NULL;
+    if (found) {
+        *stats = slot->edf->stats;
+    }
+    spinUnlock(&slot->lock);
+    preemptEnable();
+    return found ? 0 : -1;
+}
@@ -20,36 +20,161 @@
 #include <sys/types.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <signal.h>
 #include <ucontext.h>
 #include <string.h>
 #include <sys/time.h>
-
-#define STACK_SIZE 1024*64
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* 
+ * Default stack reservation. Stacks are mapped MAP_NORESERVE, so this is
+ * only address space: the kernel commits a page when the thread first
+ * touches it, and an idle thread costs a page or two.
+ */
+#define STACK_SIZE 1024*1024
+#define MIN_STACK_SIZE 1024*16
 #define RUN_TIME_USEC 200
 
+/* exited threads' stacks kept for reuse before they get unmapped */
+#define DEFAULT_STACK_POOL 256
+
+/* the hand-written switch only exists for x86-64, everything else uses ucontext */
+#if defined(FAST_SWITCH) && defined(__x86_64__)
+#define USE_FAST_SWITCH 1
+#endif
+
+/* upper bound on kernel worker threads, the default is one per online core */
+#define MAX_WORKERS 64
+
 typedef unsigned int my_pthread_t;
 
-typedef enum {READY, WAITING} t_state;
+typedef enum {READY, WAITING, FINISHED} t_state;
+
+/* 
+ * A task on the pool, or a thread outside it, counting the children it has
+ * not synced yet. TASK_WAITING is set in pending while the waiter is parked
+ * and the child that brings the count to zero readies it.
+ */
+typedef struct TaskFrame {
+    volatile long pending;
+    struct threadControlBlock * waiter;
+} TaskFrame;
+
+#define TASK_WAITING (1L << 62)
 
 typedef struct threadControlBlock {
     my_pthread_t tid;
-    my_pthread_t join_id;
-    unsigned int run_time;
+    // nanoseconds of cpu the thread consumed up to its last switch
+    unsigned long long run_time;
+    // MLFQ level, and the ns used against that level's allotment
     unsigned int priority;
+    unsigned long long allot_used;
     ucontext_t * thread_context;
+    // saved stack pointer when switching with fastSwitch
+    void * thread_sp;
     t_state thread_state;
+    // set while some worker is executing on (or still saving) this context
+    volatile unsigned int on_cpu;
+    void *(*function)(void*);
+    void * arg;
+    // set when a woken mutex waiter lost the lock, the next unlock hands it over
+    unsigned int handoff;
     struct threadControlBlock * next;
+    // pairing heap links, key and insertion order, ties on key go first in first out.
+    // prev is the parent for a first child and the left sibling otherwise
+    struct threadControlBlock * child;
+    struct threadControlBlock * sibling;
+    struct threadControlBlock * prev;
+    unsigned long long key;
+    unsigned long seq;
+    // stride scheduling share, and virtual time advanced by cpu used over tickets
+    unsigned int tickets;
+    unsigned long long pass;
+    // where the stack, this tcb and its context live, NULL for the main thread
+    struct ThreadStack * stack;
+    // deadline parameters and current job, NULL unless the thread is in the EDF class
+    struct EdfState * edf;
+    // worker whose ready queues hold the thread, NULL while it runs, blocks or is fresh
+    struct Worker * volatile rq;
+    // rank inherited from a better thread waiting on a mutex this one holds
+    unsigned int pi_boosted;
+    unsigned long long pi_rank;
+    // mutexes the thread holds, most recent first, linked through next_held
+    struct my_pthread_mutex_t * held;
+    // condition variable the thread is queued on, cleared by whoever takes it off.
+    // A timed out waiter can be on a ready queue before it leaves cond, so cond
+    // has a link of its own
+    struct my_pthread_cond_t * cond;
+    struct threadControlBlock * cond_next;
+    // COND_WAITING until a signal or the timeout claims the wakeup
+    volatile unsigned int cond_wait;
+    // worker whose sleepers heap holds the thread, NULL once it is taken off
+    struct Worker * volatile sleeping_on;
+    // task the thread is running off the pool, NULL outside any and spawns count against task_root
+    TaskFrame * task_frame;
+    TaskFrame task_root;
+    // the deque of a pool thread, NULL for every other thread
+    struct WsDeque * task_deque;
 } tcb;
 
-/* mutex struct definition */
-typedef struct my_pthread_mutex_t {
-    unsigned int lock; 
-    unsigned int destroyed; 
-    my_pthread_t tid; 
-    unsigned int initialized;
-} my_pthread_mutex_t;
+/* 
+ * One mapping carved into the stacks of a create_n batch. It is unmapped
+ * whole once the last of them is given back, instead of piece by piece.
+ */
+typedef struct StackSlab {
+    char * base;
+    size_t length;
+    // stacks of the slab not given back yet
+    volatile int live;
+} StackSlab;
+
+/* 
+ * Header at the top of an mmap'd thread stack. The tcb and context live
+ * here too, and a PROT_NONE guard page sits below the stack so an
+ * overflow faults instead of running into the neighbouring mapping.
+ */
+typedef struct ThreadStack {
+    tcb block;
+    ucontext_t context;
+    // start of the mapping, the guard pages come first
+    char * base;
+    size_t length;
+    size_t guard;
+    // mapping shared with the rest of its batch, NULL for a mapping of its own
+    StackSlab * slab;
+    struct ThreadStack * next;
+} ThreadStack;
+
+/* thread attributes */
+typedef struct my_pthread_attr_t {
+    // bytes reserved for the stack
+    size_t stacksize;
+    // PROT_NONE bytes below the stack, rounded up to whole pages
+    size_t guardsize;
+    // share of the cpu under the stride policy
+    unsigned int tickets;
+    // create yields so the new thread runs right away, 1 by default
+    int yield;
+    // MY_PTHREAD_CREATE_DETACHED threads free their slot as they exit
+    int detachstate;
+} my_pthread_attr_t;
+
+#define MY_PTHREAD_CREATE_JOINABLE 0
+#define MY_PTHREAD_CREATE_DETACHED 1
+
+/* stack pool counters */
+typedef struct my_pthread_stackstats_t {
+    // stacks sitting in the pool right now, and the most there ever were
+    unsigned long pooled;
+    unsigned long high_water;
+    // creates served from the pool, and ones that had to mmap
+    unsigned long reused;
+    unsigned long mapped;
+} my_pthread_stackstats_t;
 
 // priority queue for threads
 typedef struct TcbQueue {
@@ -57,61 +182,415 @@ typedef struct TcbQueue {
     tcb * tail;
 } TcbQueue;
 
-typedef struct TcbReturn {
-	my_pthread_t tid;
-	void * returnVal;
-	struct TcbReturn * next;
-} ret;
+/* mutex lock states */
+#define MUTEX_FREE 0
+#define MUTEX_LOCKED 1
+#define MUTEX_CONTENDED 2
 
-typedef struct RetQueue {
-    ret * head;
-    ret * tail;
-} RetQueue;
+/* spins a contended lock tries while its owner runs on another worker */
+#define DEFAULT_MUTEX_SPIN 100
 
+/* mutex attributes */
+typedef struct my_pthread_mutexattr_t {
+    // spin budget before parking, 0 parks right away
+    int spin;
+} my_pthread_mutexattr_t;
 
-/* Function Declarations: */
-static void schedule();
+/* mutex struct definition */
+typedef struct my_pthread_mutex_t {
+    // MUTEX_CONTENDED while waiters are parked and nobody was woken for them
+    volatile unsigned int lock; 
+    unsigned int destroyed; 
+    my_pthread_t tid; 
+    unsigned int initialized;
+    // holder of the lock, only read under guard. Spinners go by tid, the
+    // holder's tcb may be gone with its stack by the time they look
+    tcb * volatile owner;
+    int spin;
+    // contended acquires that got the lock by spinning, and ones that parked
+    unsigned long spin_acquires;
+    unsigned long parks;
+    // protects waiters, only taken when the lock is contended
+    volatile unsigned int guard;
+    // threads parked in lock, in arrival order
+    TcbQueue waiters;
+    // next mutex held by the same owner, only the owner touches it
+    struct my_pthread_mutex_t * next_held;
+} my_pthread_mutex_t;
 
-ret * findRet(my_pthread_t tid, RetQueue * queue);
+/* who claimed a condition variable waiter's wakeup, a signal or its timeout */
+#define COND_NONE 0
+#define COND_WAITING 1
+#define COND_SIGNALLED 2
+#define COND_TIMEDOUT 3
 
-void removeFromRetQueue(ret *toDequeue, RetQueue * queue);
+/* condition variable attributes, there are none yet */
+typedef struct my_pthread_condattr_t {
+    int unused;
+} my_pthread_condattr_t;
 
-void removeFromTcbQueue(tcb *toDequeue, TcbQueue * queue);
-
-static void sched_stcf();
+/* condition variable struct definition */
+typedef struct my_pthread_cond_t {
+    unsigned int initialized;
+    // protects waiters
+    volatile unsigned int guard;
+    // threads parked in wait, in arrival order, linked through cond_next
+    TcbQueue waiters;
+} my_pthread_cond_t;
+
+/* 
+ * rwlock state word: the readers holding it in the low bits, RW_WRITER
+ * while a writer does, RW_WAITERS while anyone is parked or a woken
+ * writer has yet to get in, which sends every acquire and release
+ * through the guard
+ */
+#define RW_WRITER 0x80000000u
+#define RW_WAITERS 0x40000000u
+#define RW_READERS 0x3fffffffu
+
+/* rwlock attributes */
+typedef struct my_pthread_rwlockattr_t {
+    // parked writers go before parked and newly arriving readers
+    int prefer_writer;
+} my_pthread_rwlockattr_t;
+
+/* reader-writer lock struct definition */
+typedef struct my_pthread_rwlock_t {
+    volatile unsigned int state;
+    unsigned int initialized;
+    int prefer_writer;
+    // tid of the writer holding it
+    my_pthread_t writer;
+    // protects the rest, only taken when RW_WAITERS is or is about to be set
+    volatile unsigned int guard;
+    // threads parked in rdlock and wrlock, in arrival order
+    TcbQueue readers;
+    TcbQueue writers;
+    // parked writers plus woken ones that have not got in yet, readers defer to them
+    unsigned int writers_waiting;
+} my_pthread_rwlock_t;
+
+/* counting semaphore struct definition */
+typedef struct my_pthread_sem_t {
+    volatile int value;
+    unsigned int initialized;
+    // protects waiters, posts only take it when someone is parked
+    volatile unsigned int guard;
+    // threads parked in wait, in arrival order
+    TcbQueue waiters;
+} my_pthread_sem_t;
+
+/* what barrier wait returns to exactly one of the threads it releases */
+#define MY_PTHREAD_BARRIER_SERIAL_THREAD -1
+
+/* barrier attributes, there are none yet */
+typedef struct my_pthread_barrierattr_t {
+    int unused;
+} my_pthread_barrierattr_t;
+
+/* barrier struct definition */
+typedef struct my_pthread_barrier_t {
+    // threads each round waits for, and how many are in so far
+    unsigned int count;
+    unsigned int arrived;
+    unsigned int initialized;
+    volatile unsigned int guard;
+    // threads parked in the current round
+    TcbQueue waiters;
+} my_pthread_barrier_t;
+
+/* 
+ * A thread parked on a channel, one per case for a select. The message
+ * travels through msg: what a sender is passing, or what a receiver got.
+ * The cases of one select share fired, the first channel to CAS it from 0
+ * to its index + 1 gets to complete that case, the others skip the rest.
+ */
+typedef struct ChanWaiter {
+    struct threadControlBlock * thread;
+    void * msg;
+    // 1 once the message went through, 0 if the channel was closed instead
+    int ok;
+    volatile int * fired;
+    int index;
+    // still on the channel's queue
+    int queued;
+    struct ChanWaiter * next;
+    struct ChanWaiter * prev;
+} ChanWaiter;
+
+typedef struct ChanQueue {
+    ChanWaiter * head;
+    ChanWaiter * tail;
+} ChanQueue;
+
+/* a capacity of 0 leaves the channel's buffer unbounded */
+#define MY_CHAN_UNBOUNDED 0
+
+/* channel struct definition */
+typedef struct my_chan_t {
+    volatile unsigned int guard;
+    unsigned int initialized;
+    unsigned int capacity;
+    int closed;
+    // buffered messages, a ring of size entries with count of them from head on
+    void ** buf;
+    unsigned int size;
+    unsigned int head;
+    unsigned int count;
+    // parked senders only ever wait on a full bounded buffer, receivers on an empty one
+    ChanQueue senders;
+    ChanQueue receivers;
+} my_chan_t;
+
+#define MY_CHAN_RECV 0
+#define MY_CHAN_SEND 1
+
+/* one case of a select: send msg on chan, or receive from chan into msg */
+typedef struct my_chan_case_t {
+    my_chan_t * chan;
+    int op;
+    void * msg;
+    // set by select for the case it completes, 0 means chan was closed
+    int ok;
+} my_chan_case_t;
+
+/* 
+ * Entry of the tid-indexed thread table. It outlives the tcb so join can
+ * find out a thread is gone and collect its return value in O(1).
+ */
+typedef struct ThreadSlot {
+    volatile unsigned int lock;
+    t_state state;
+    // NULL once the thread has exited
+    tcb * block;
+    // threads blocked joining this one, linked through next
+    tcb * joiners;
+    void * returnVal;
+    // the thread's final cpu time once it has exited
+    unsigned long long run_time;
+    // copy of the tcb's on_cpu that mutex spinners can read after the thread is gone
+    volatile unsigned int on_cpu;
+    // EDF parameters and counters, set once the thread joined the class
+    struct EdfState * edf;
+    // cleared once the thread is detached or joined, the slot then goes back for reuse
+    int joinable;
+    // joiners that have not picked up the return value yet
+    int joining;
+    // next free tid while the slot is unused
+    my_pthread_t next_free;
+} ThreadSlot;
+
+/* deadline-miss counters of an EDF thread, see my_pthread_getdeadlinestats */
+typedef struct my_pthread_edfstats_t {
+    // jobs finished with my_pthread_waitperiod, and the ones that finished late
+    unsigned long jobs;
+    unsigned long misses;
+    // worst finish minus deadline (negative while every job had slack), and worst finish minus release
+    long long worst_lateness_ns;
+    unsigned long long worst_response_ns;
+} my_pthread_edfstats_t;
+
+/* 
+ * A thread in the EDF class gets runtime ns of cpu every period, each job
+ * due deadline ns after its release. The thread table keeps it after the
+ * thread exits so the counters can still be read.
+ */
+typedef struct EdfState {
+    unsigned long long runtime;
+    unsigned long long deadline;
+    unsigned long long period;
+    // current job, the deadline it is scheduled by and the run_time its budget counts from
+    unsigned long long release;
+    unsigned long long abs_deadline;
+    unsigned long long job_base;
+    // still counted in edfUtil, cleared when the thread leaves the class
+    int admitted;
+    my_pthread_edfstats_t stats;
+} EdfState;
+
+/* share of each worker the EDF class may reserve, admission control turns down the rest */
+#define EDF_MAX_UTIL_PERCENT 90
+
+/* the table grows a chunk at a time so slots never move */
+#define SLOT_CHUNK 4096
+#define MAX_SLOT_CHUNKS 65536
+
+/* pairing heap of tcbs ordered by key (run_time for STCF, pass for stride), the root is the smallest */
+typedef struct TcbHeap {
+    tcb * root;
+    unsigned long seq;
+} TcbHeap;
+
+/* ring backing a work-stealing deque, size is mask + 1 and a power of two */
+typedef struct DequeArray {
+    long mask;
+    struct DequeArray * retired;
+    void * slot[];
+} DequeArray;
+
+/*
+ * Chase-Lev work-stealing deque of fresh tcbs or pool tasks. The owner
+ * pushes and pops at the bottom without locking, others steal from the
+ * top with a CAS.
+ */
+typedef struct WsDeque {
+    volatile long top __attribute__((aligned(64)));
+    volatile long bottom __attribute__((aligned(64)));
+    DequeArray * volatile array;
+} WsDeque;
+
+/* 
+ * A unit of work on the task pool: function(arg), or a piece of a
+ * my_parallel_for that runs body over [start, end) after splitting off
+ * halves until it is no bigger than grain
+ */
+typedef struct Task {
+    void (*function)(void *);
+    void (*body)(long, long, void *);
+    void * arg;
+    long start;
+    long end;
+    long grain;
+    // frame of the spawner, its pending count drops when this task is done
+    TaskFrame * parent;
+    // link on the pool's inject list
+    struct Task * next;
+} Task;
+
+/* pool threads, one per worker, running tasks off their own deques and stealing the rest */
+typedef struct TaskPool {
+    int size;
+    WsDeque deques[MAX_WORKERS];
+    // pool threads that found nothing to do, and the semaphore they park on
+    volatile int idle;
+    my_pthread_sem_t wake;
+    // tasks spawned by threads outside the pool, oldest first
+    volatile unsigned int lock;
+    Task * inject_head;
+    Task * inject_tail;
+} TaskPool;
+
+/* 
+ * MLFQ defaults. Level q gets a quantum of RUN_TIME_USEC*(q+1) and an
+ * allotment of DEFAULT_MLFQ_ALLOT quanta before it is demoted, and every
+ * DEFAULT_MLFQ_BOOST_USEC the ready threads go back to the top.
+ */
+#define MAX_MLFQ_LEVELS 8
+#define DEFAULT_MLFQ_LEVELS 4
+#define DEFAULT_MLFQ_ALLOT 2
+#define DEFAULT_MLFQ_BOOST_USEC 50000
+
+/* MLFQ tuning, see my_pthread_setmlfq */
+typedef struct my_pthread_mlfqattr_t {
+    int levels;
+    // time slice of each level
+    unsigned int quantum_usec[MAX_MLFQ_LEVELS];
+    // cpu a thread may use at a level, over any number of slices, before demotion
+    unsigned int allot_usec[MAX_MLFQ_LEVELS];
+    // period of the priority boost, 0 never boosts
+    unsigned int boost_usec;
+} my_pthread_mlfqattr_t;
+
+/* 
+ * Stride scheduling: a thread's pass advances by the ns it ran times
+ * STRIDE1 / tickets, and the smallest pass runs next
+ */
+#define DEFAULT_TICKETS 100
+#define STRIDE1 (1 << 16)
+
+/* a kernel thread that runs its own scheduler loop over the tcbs */
+typedef struct Worker {
+    int id;
+    pthread_t kthread;
+    pid_t ktid;
+    timer_t timer;
+    // the tcb this worker is running right now
+    tcb * current;
+    // the thread we just switched away from, cleaned up by the next thread
+    tcb * prev;
+    // context running the worker's loop when it has nothing to do
+    tcb * idle;
+    // CLOCK_MONOTONIC ns when the current slice started, and when it runs out
+    unsigned long long slice_start;
+    volatile unsigned long long slice_end;
+    // the slice ran out while the worker was inside the library
+    volatile int need_resched;
+    // threads created here that have not run yet
+    WsDeque fresh;
+    // guards readyQueues against thieves and wakeups from other workers
+    volatile unsigned int lock __attribute__((aligned(64)));
+    // threads that have run on this worker, STCF keeps them in readyHeap
+    TcbQueue readyQueues[MAX_MLFQ_LEVELS];
+    TcbHeap readyHeap;
+    // when this worker next boosts its MLFQ queues
+    unsigned long long next_boost;
+    // stride: pass of the thread picked last, where newcomers start
+    unsigned long long vtime;
+    // EDF threads, earliest absolute deadline first; they run before the policy's
+    TcbHeap edfHeap;
+    // threads sleeping until their key in CLOCK_MONOTONIC ns
+    TcbHeap sleepers;
+} __attribute__((aligned(64))) worker;
+
+
+/* 
+ * Scheduling policy. Every hook runs on the worker w with w->lock held,
+ * pick_next may also be called by a thief on the victim's queues.
+ */
+typedef struct SchedOps {
+    const char * name;
+    // takes the next thread to run off w's ready queues, NULL if empty
+    tcb * (*pick_next)(struct Worker * w);
+    // puts a runnable thread on w's ready queues
+    void (*enqueue)(struct Worker * w, tcb * t);
+    // the running thread t (NULL if idle) was charged used ns at a schedule
+    void (*on_tick)(struct Worker * w, tcb * t, unsigned long long used);
+    // t is going off the cpu to block or exit
+    void (*on_block)(struct Worker * w, tcb * t);
+    // t was blocked and is about to be enqueued
+    void (*on_wake)(struct Worker * w, tcb * t);
+    // ns t may run before the tick preempts it
+    unsigned long long (*slice)(tcb * t);
+    // where t stands in the policy, smaller runs sooner; a mutex owner inherits its best waiter's
+    unsigned long long (*rank)(tcb * t);
+    // takes a thread that is on w's ready queues off them again
+    void (*remove)(struct Worker * w, tcb * t);
+} SchedOps;
 
-static void sched_mlfq();
+/* Function Declarations: */
+void removeFromTcbQueue(tcb *toDequeue, TcbQueue * queue);
 
 void init();
 
-tcb * getSJF(TcbQueue * queue);
-
 void printTcbQueue(TcbQueue * queue);
 
-tcb * findTCB(my_pthread_t tid, TcbQueue * queue);
-
 tcb * dequeueTcb(TcbQueue * queue);
 
-ret * dequeueRet(RetQueue * queue);
-
-int enqueueRet(ret * toInsert, RetQueue *queue);
-
 int enqueueTcb(tcb * toInsert, TcbQueue *queue);
 
 /* create a new thread */
-int my_pthread_create(my_pthread_t * thread, pthread_attr_t * attr, void *(*function)(void*), void * arg);
+int my_pthread_create(my_pthread_t * thread, my_pthread_attr_t * attr, void *(*function)(void*), void * arg);
+
+/* create n threads from one stack mapping with a single yield, thread i gets args[i] (NULL if args is) */
+int my_pthread_create_n(my_pthread_t * threads, int n, my_pthread_attr_t * attr, void *(*function)(void*), void ** args);
 
 /* give CPU pocession to other user level threads voluntarily */
 int my_pthread_yield();
 
+/* give the CPU straight to thread if it is ready, a plain yield returning -1 if it is not */
+int my_pthread_yield_to(my_pthread_t thread);
+
 /* terminate a thread */
 void my_pthread_exit(void *value_ptr);
 
 /* wait for thread termination */
 int my_pthread_join(my_pthread_t thread, void **value_ptr);
 
+/* nobody will join thread, its slot is freed as soon as it exits */
+int my_pthread_detach(my_pthread_t thread);
+
 /* initial the mutex lock */
-int my_pthread_mutex_init(my_pthread_mutex_t *mutex, const pthread_mutexattr_t *mutexattr);
+int my_pthread_mutex_init(my_pthread_mutex_t *mutex, const my_pthread_mutexattr_t *mutexattr);
 
 /* aquire the mutex lock */
 int my_pthread_mutex_lock(my_pthread_mutex_t *mutex);
@@ -122,16 +601,296 @@ int my_pthread_mutex_unlock(my_pthread_mutex_t *mutex);
 /* destroy the mutex */
 int my_pthread_mutex_destroy(my_pthread_mutex_t *mutex);
 
-#ifdef USE_MY_PTHREAD
+/* read how often contended acquires spun their way in or parked */
+int my_pthread_mutex_getstats(my_pthread_mutex_t *mutex, unsigned long *spin_acquires, unsigned long *parks);
+
+/* initialize mutex attributes to the defaults */
+int my_pthread_mutexattr_init(my_pthread_mutexattr_t *attr);
+
+/* destroy mutex attributes */
+int my_pthread_mutexattr_destroy(my_pthread_mutexattr_t *attr);
+
+/* set how many times a contended lock spins before it parks */
+int my_pthread_mutexattr_setspin(my_pthread_mutexattr_t *attr, int spin);
+
+/* get the spin budget */
+int my_pthread_mutexattr_getspin(const my_pthread_mutexattr_t *attr, int *spin);
+
+/* set the number of kernel workers, must be called before the first create */
+int my_pthread_setconcurrency(int workers);
+
+/* number of kernel workers in use */
+int my_pthread_getconcurrency();
+
+/* initialize thread attributes to the defaults */
+int my_pthread_attr_init(my_pthread_attr_t *attr);
+
+/* destroy thread attributes */
+int my_pthread_attr_destroy(my_pthread_attr_t *attr);
+
+/* set the stack reservation of threads created with attr */
+int my_pthread_attr_setstacksize(my_pthread_attr_t *attr, size_t stacksize);
+
+/* get the stack reservation */
+int my_pthread_attr_getstacksize(const my_pthread_attr_t *attr, size_t *stacksize);
+
+/* set the guard size, 0 drops the guard page */
+int my_pthread_attr_setguardsize(my_pthread_attr_t *attr, size_t guardsize);
+
+/* get the guard size */
+int my_pthread_attr_getguardsize(const my_pthread_attr_t *attr, size_t *guardsize);
+
+/* set the stride tickets of threads created with attr */
+int my_pthread_attr_settickets(my_pthread_attr_t *attr, unsigned int tickets);
+
+/* get the stride tickets */
+int my_pthread_attr_gettickets(const my_pthread_attr_t *attr, unsigned int *tickets);
+
+/* whether creating with attr yields so the new threads get to run, 0 leaves them queued */
+int my_pthread_attr_setyield(my_pthread_attr_t *attr, int yield);
+
+/* get whether create yields */
+int my_pthread_attr_getyield(const my_pthread_attr_t *attr, int *yield);
+
+/* create threads joinable or detached */
+int my_pthread_attr_setdetachstate(my_pthread_attr_t *attr, int detachstate);
+
+/* get the detach state */
+int my_pthread_attr_getdetachstate(const my_pthread_attr_t *attr, int *detachstate);
+
+/* cap the number of exited threads' stacks kept for reuse */
+int my_pthread_setstackpool(int cap);
+
+/* read the stack pool counters */
+int my_pthread_getstackstats(my_pthread_stackstats_t *stats);
+
+/* 
+ * cpu time a thread has used in ns, exact for the caller, as of its last
+ * switch for others. Fails once the thread is joined or exits detached.
+ */
+int my_pthread_getcputime(my_pthread_t thread, unsigned long long *nsec);
+
+/* initialize MLFQ tuning to the defaults */
+int my_pthread_mlfqattr_init(my_pthread_mlfqattr_t *attr);
+
+/* set the MLFQ levels, quanta, allotments and boost, must be called before the first create */
+int my_pthread_setmlfq(const my_pthread_mlfqattr_t *attr);
+
+/* read the MLFQ tuning in use */
+int my_pthread_getmlfq(my_pthread_mlfqattr_t *attr);
+
+/* change a thread's stride tickets, 1 to STRIDE1 */
+int my_pthread_settickets(my_pthread_t thread, unsigned int tickets);
+
+/* read a thread's stride tickets */
+int my_pthread_gettickets(my_pthread_t thread, unsigned int *tickets);
+
+/* initialize a condition variable */
+int my_pthread_cond_init(my_pthread_cond_t *cond, const my_pthread_condattr_t *condattr);
+
+/* unlock mutex and park until signalled, the mutex is held again on return */
+int my_pthread_cond_wait(my_pthread_cond_t *cond, my_pthread_mutex_t *mutex);
+
+/* like wait but gives up at abstime (CLOCK_REALTIME) and returns ETIMEDOUT */
+int my_pthread_cond_timedwait(my_pthread_cond_t *cond, my_pthread_mutex_t *mutex,
+                              const struct timespec *abstime);
+
+/* wake one waiter */
+int my_pthread_cond_signal(my_pthread_cond_t *cond);
+
+/* wake every waiter */
+int my_pthread_cond_broadcast(my_pthread_cond_t *cond);
+
+/* destroy a condition variable nobody waits on */
+int my_pthread_cond_destroy(my_pthread_cond_t *cond);
+
+/* initialize a reader-writer lock */
+int my_pthread_rwlock_init(my_pthread_rwlock_t *rwlock, const my_pthread_rwlockattr_t *rwlockattr);
+
+/* acquire the lock shared */
+int my_pthread_rwlock_rdlock(my_pthread_rwlock_t *rwlock);
+
+/* acquire the lock exclusive */
+int my_pthread_rwlock_wrlock(my_pthread_rwlock_t *rwlock);
+
+/* acquire the lock shared if that needs no waiting, EBUSY otherwise */
+int my_pthread_rwlock_tryrdlock(my_pthread_rwlock_t *rwlock);
+
+/* acquire the lock exclusive if that needs no waiting, EBUSY otherwise */
+int my_pthread_rwlock_trywrlock(my_pthread_rwlock_t *rwlock);
+
+/* release a shared or exclusive hold */
+int my_pthread_rwlock_unlock(my_pthread_rwlock_t *rwlock);
+
+/* destroy a reader-writer lock nobody holds */
+int my_pthread_rwlock_destroy(my_pthread_rwlock_t *rwlock);
+
+/* initialize rwlock attributes to the defaults */
+int my_pthread_rwlockattr_init(my_pthread_rwlockattr_t *attr);
+
+/* destroy rwlock attributes */
+int my_pthread_rwlockattr_destroy(my_pthread_rwlockattr_t *attr);
+
+/* set whether waiting writers go before readers (the default) or after them */
+int my_pthread_rwlockattr_setpreferwriter(my_pthread_rwlockattr_t *attr, int prefer_writer);
+
+/* get the writer preference */
+int my_pthread_rwlockattr_getpreferwriter(const my_pthread_rwlockattr_t *attr, int *prefer_writer);
+
+/* initialize a semaphore to value */
+int my_pthread_sem_init(my_pthread_sem_t *sem, unsigned int value);
+
+/* take one unit, parking until one is posted */
+int my_pthread_sem_wait(my_pthread_sem_t *sem);
+
+/* take one unit if there is one, EAGAIN otherwise */
+int my_pthread_sem_trywait(my_pthread_sem_t *sem);
+
+/* give back one unit */
+int my_pthread_sem_post(my_pthread_sem_t *sem);
+
+/* give back n units, waking up to n waiters in one batch */
+int my_pthread_sem_postn(my_pthread_sem_t *sem, unsigned int n);
+
+/* read the units available */
+int my_pthread_sem_getvalue(my_pthread_sem_t *sem, int *value);
+
+/* destroy a semaphore nobody waits on */
+int my_pthread_sem_destroy(my_pthread_sem_t *sem);
+
+/* initialize a barrier that releases every count threads */
+int my_pthread_barrier_init(my_pthread_barrier_t *barrier, const my_pthread_barrierattr_t *barrierattr,
+                            unsigned int count);
+
+/* park until count threads have arrived, one of them gets MY_PTHREAD_BARRIER_SERIAL_THREAD */
+int my_pthread_barrier_wait(my_pthread_barrier_t *barrier);
+
+/* destroy a barrier nobody waits on */
+int my_pthread_barrier_destroy(my_pthread_barrier_t *barrier);
+
+/* initialize barrier attributes */
+int my_pthread_barrierattr_init(my_pthread_barrierattr_t *attr);
+
+/* destroy barrier attributes */
+int my_pthread_barrierattr_destroy(my_pthread_barrierattr_t *attr);
+
+/* initialize a channel buffering up to capacity messages, MY_CHAN_UNBOUNDED for no limit */
+int my_chan_init(my_chan_t *chan, unsigned int capacity);
+
+/* pass msg on, parking while a bounded buffer is full; -1 once the channel is closed */
+int my_chan_send(my_chan_t *chan, void *msg);
+
+/* take the next message, parking while there is none; -1 once the channel is closed and drained */
+int my_chan_recv(my_chan_t *chan, void **msg);
+
+/* 
+ * complete one of n sends and receives, parking until one can go through
+ * unless block is 0. Returns the index of the case done, -1 if none could
+ * be without blocking
+ */
+int my_chan_select(my_chan_case_t *cases, int n, int block);
+
+/* no more sends, parked senders and receivers get -1 and buffered messages can still be received */
+int my_chan_close(my_chan_t *chan);
+
+/* destroy a channel nobody waits on */
+int my_chan_destroy(my_chan_t *chan);
+
+/* run function(arg) on the task pool as a child of the calling task */
+int my_task_spawn(void (*function)(void *), void *arg);
+
+/* wait for every child the caller spawned, a pool thread runs pool tasks meanwhile */
+int my_task_sync();
+
+/* 
+ * run body(lo, hi, arg) over [start, end) on the task pool in pieces of
+ * at most grain, 0 picks one; returns once every piece is done
+ */
+int my_parallel_for(long start, long end, long grain, void (*body)(long, long, void *), void *arg);
+
+/* 
+ * put the caller in the EDF class: runtime usec of cpu every period usec,
+ * due deadline usec after each release. Fails if it would overcommit the
+ * workers, all zero leaves the class.
+ */
+int my_pthread_setdeadline(unsigned long runtime_usec, unsigned long deadline_usec,
+                           unsigned long period_usec);
+
+/* an EDF thread ends its current job, sleeping until the next release if it is early */
+int my_pthread_waitperiod();
+
+/* read an EDF thread's deadline-miss counters, fails once it is joined or exits detached */
+int my_pthread_getdeadlinestats(my_pthread_t thread, my_pthread_edfstats_t *stats);
+
+/* pick the scheduling policy by name ("stcf", "mlfq" or "stride"), must be called before the first create */
+int my_pthread_setpolicy(const char *name);
+
+/* name of the scheduling policy in use */
+const char * my_pthread_getpolicy();
+
+/* my_pthread.c needs the real pthread calls to start its kernel workers */
+#if defined(USE_MY_PTHREAD) && !defined(MY_PTHREAD_INTERNAL)
 #define pthread_t my_pthread_t
 #define pthread_mutex_t my_pthread_mutex_t
 #define pthread_create my_pthread_create
+#define pthread_yield my_pthread_yield
+#define pthread_attr_t my_pthread_attr_t
+#define pthread_attr_init my_pthread_attr_init
+#define pthread_attr_destroy my_pthread_attr_destroy
+#define pthread_attr_setstacksize my_pthread_attr_setstacksize
+#define pthread_attr_getstacksize my_pthread_attr_getstacksize
+#define pthread_attr_setguardsize my_pthread_attr_setguardsize
+#define pthread_attr_getguardsize my_pthread_attr_getguardsize
 #define pthread_exit my_pthread_exit
 #define pthread_join my_pthread_join
+#define pthread_detach my_pthread_detach
+#define pthread_attr_setdetachstate my_pthread_attr_setdetachstate
+#define pthread_attr_getdetachstate my_pthread_attr_getdetachstate
+#undef PTHREAD_CREATE_JOINABLE
+#define PTHREAD_CREATE_JOINABLE MY_PTHREAD_CREATE_JOINABLE
+#undef PTHREAD_CREATE_DETACHED
+#define PTHREAD_CREATE_DETACHED MY_PTHREAD_CREATE_DETACHED
 #define pthread_mutex_init my_pthread_mutex_init
 #define pthread_mutex_lock my_pthread_mutex_lock
 #define pthread_mutex_unlock my_pthread_mutex_unlock
 #define pthread_mutex_destroy my_pthread_mutex_destroy
+#define pthread_mutexattr_t my_pthread_mutexattr_t
+#define pthread_mutexattr_init my_pthread_mutexattr_init
+#define pthread_mutexattr_destroy my_pthread_mutexattr_destroy
+#define pthread_mutexattr_setspin my_pthread_mutexattr_setspin
+#define pthread_mutexattr_getspin my_pthread_mutexattr_getspin
+#define pthread_cond_t my_pthread_cond_t
+#define pthread_condattr_t my_pthread_condattr_t
+#define pthread_cond_init my_pthread_cond_init
+#define pthread_cond_wait my_pthread_cond_wait
+#define pthread_cond_timedwait my_pthread_cond_timedwait
+#define pthread_cond_signal my_pthread_cond_signal
+#define pthread_cond_broadcast my_pthread_cond_broadcast
+#define pthread_cond_destroy my_pthread_cond_destroy
+#define pthread_rwlock_t my_pthread_rwlock_t
+#define pthread_rwlockattr_t my_pthread_rwlockattr_t
+#define pthread_rwlock_init my_pthread_rwlock_init
+#define pthread_rwlock_rdlock my_pthread_rwlock_rdlock
+#define pthread_rwlock_wrlock my_pthread_rwlock_wrlock
+#define pthread_rwlock_tryrdlock my_pthread_rwlock_tryrdlock
+#define pthread_rwlock_trywrlock my_pthread_rwlock_trywrlock
+#define pthread_rwlock_unlock my_pthread_rwlock_unlock
+#define pthread_rwlock_destroy my_pthread_rwlock_destroy
+#define pthread_rwlockattr_init my_pthread_rwlockattr_init
+#define pthread_rwlockattr_destroy my_pthread_rwlockattr_destroy
+#define pthread_rwlockattr_setpreferwriter my_pthread_rwlockattr_setpreferwriter
+#define pthread_rwlockattr_getpreferwriter my_pthread_rwlockattr_getpreferwriter
+#define pthread_barrier_t my_pthread_barrier_t
+#define pthread_barrierattr_t my_pthread_barrierattr_t
+#define pthread_barrier_init my_pthread_barrier_init
+#define pthread_barrier_wait my_pthread_barrier_wait
+#define pthread_barrier_destroy my_pthread_barrier_destroy
+#define pthread_barrierattr_init my_pthread_barrierattr_init
+#define pthread_barrierattr_destroy my_pthread_barrierattr_destroy
+#undef PTHREAD_BARRIER_SERIAL_THREAD
+#define PTHREAD_BARRIER_SERIAL_THREAD MY_PTHREAD_BARRIER_SERIAL_THREAD
+#define pthread_setconcurrency my_pthread_setconcurrency
+#define pthread_getconcurrency my_pthread_getconcurrency
 #endif
 
 #endif